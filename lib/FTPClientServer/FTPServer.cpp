@@ -262,6 +262,7 @@ void FTPServer::handleFTP()
       {
         closeTransfer();
         transferState = tIdle;
+        notifyChange(storePath);
       }
     }
   }
@@ -512,6 +513,7 @@ int8_t FTPServer::processCommand()
       else if (THEFS.remove(path))
       {
         sendMessage_P(250, PSTR("Delete operation successful."));
+        notifyChange(path);
       }
       else
       {
@@ -701,6 +703,7 @@ int8_t FTPServer::processCommand()
         else if (rc > 0)
         {
           transferState = tStore;
+          storePath = path;
           millisBeginTrans = millis();
           bytesTransfered = 0;
           if (allocateBuffer())
@@ -730,6 +733,7 @@ int8_t FTPServer::processCommand()
     if (THEFS.mkdir(path))
     {
       sendMessage_P(257, PSTR("\"%s\" created."), path.c_str());
+      notifyChange(path);
     }
     else
     {
@@ -765,6 +769,7 @@ int8_t FTPServer::processCommand()
     {
       THEFS.rmdir(path);
       sendMessage_P(250, PSTR("Remove directory operation successful."));
+      notifyChange(path);
     }
 #endif
   }
@@ -801,7 +806,11 @@ int8_t FTPServer::processCommand()
     {
       FTP_DEBUG_MSG("Renaming '%s' to '%s'", rnFrom.c_str(), path.c_str());
       if (THEFS.rename(rnFrom, path))
+      {
         sendMessage_P(250, PSTR("File successfully renamed or moved"));
+        notifyChange(rnFrom);
+        notifyChange(path);
+      }
       else
         sendMessage_P(451, PSTR("Rename/move failure."));
     }
@@ -933,6 +942,7 @@ void FTPServer::closeTransfer()
 
 void FTPServer::abortTransfer()
 {
+  bool stored = transferState == tStore;
   if (transferState > tIdle)
   {
     file.close();
@@ -941,6 +951,14 @@ void FTPServer::abortTransfer()
   }
   freeBuffer();
   transferState = tIdle;
+  if (stored) // a part of the file has been written
+    notifyChange(storePath);
+}
+
+void FTPServer::notifyChange(const String &path)
+{
+  if (changeCallback)
+    changeCallback(path);
 }
 
 // Read a char from client connected to ftp server
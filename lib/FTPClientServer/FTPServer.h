@@ -30,6 +30,7 @@
  **                                                                            **
  *******************************************************************************/
 #include "FTPCommon.h"
+#include <functional>
 
 class FTPServer : public FTPCommon
 {
@@ -49,6 +50,11 @@ public:
   // to process ftp requests
   void handleFTP();
 
+  // called with the path of every file or directory a client
+  // has stored, deleted, created or renamed
+  typedef std::function<void(const String &path)> ChangeCallback;
+  void onChange(ChangeCallback cb) { changeCallback = cb; }
+
 private:
   enum internalState
   {
@@ -89,6 +95,9 @@ private:
   String parameters;           // parameters sent by client
   String cwd;                  // the current directory
   String rnFrom;               // previous command was RNFR, this is the source file name
+  String storePath;            // file being received by STOR
+  ChangeCallback changeCallback = nullptr;
+  void notifyChange(const String &path);
 
   internalState cmdState, // state of ftp control connection
       transferState;      // state of ftp data connection
@@ -237,3 +237,40 @@ void ExternalEEPROM::write(uint32_t eepromLocation, const uint8_t *dataToWrite,
       delay(settings.pageWriteTime_ms); //Delay the amount of time to record a page
   }
 }
+
+//Write up to one page in a single I2C transaction, the data must not cross a page line
+//Needs pageSize + 2 bytes of I2C buffer, returns false if that is not available or the EEPROM
+//did not acknowledge. The write cycle is not waited for, the next access polls for it.
+bool ExternalEEPROM::writePage(uint32_t eepromLocation, const uint8_t *dataToWrite, uint16_t blockSize)
+{
+  if (blockSize == 0 || blockSize + 2 > I2C_BUFFER_LENGTH_TX)
+    return (false);
+  if ((eepromLocation / settings.pageSize_bytes) != ((eepromLocation + blockSize - 1) / settings.pageSize_bytes))
+    return (false);
+
+  uint8_t i2cAddress = settings.deviceAddress;
+  if (settings.memorySize_bytes > 0xFFFF && eepromLocation > 0xFFFF)
+    i2cAddress |= 0b100; //Set the block bit to 1
+
+  if (waitForWriteComplete(i2cAddress) == false) //Previous write cycle still running
+    return (false);
+
+  settings.i2cPort->beginTransmission(i2cAddress);
+  settings.i2cPort->write((uint8_t)(eepromLocation >> 8));   // MSB
+  settings.i2cPort->write((uint8_t)(eepromLocation & 0xFF)); // LSB
+  settings.i2cPort->write(dataToWrite, blockSize);
+  return (settings.i2cPort->endTransmission() == 0); //Send stop condition, starts the write cycle
+}
+
+//Poll the device until it acknowledges its address again (internal write cycle finished)
+//Returns false if it is still busy after twice the page write time
+bool ExternalEEPROM::waitForWriteComplete(uint8_t i2cAddress)
+{
+  uint32_t startTime = millis();
+  while (isBusy(i2cAddress) == true)
+  {
+    if (millis() - startTime > 2u * settings.pageWriteTime_ms)
+      return (false);
+  }
+  return (true);
+}
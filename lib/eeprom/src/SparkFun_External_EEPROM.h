@@ -54,6 +54,11 @@
 #define I2C_BUFFER_LENGTH_RX I2C_BUFFER_LENGTH
 #define I2C_BUFFER_LENGTH_TX I2C_BUFFER_LENGTH
 
+#elif defined(FV1_NATIVE)
+
+#define I2C_BUFFER_LENGTH_RX BUFFER_LENGTH //Linux stand-in of Wire.h in lib/fv1_native
+#define I2C_BUFFER_LENGTH_TX BUFFER_LENGTH
+
 #else
 
 #pragma GCC error "This platform doesn't have a wire buffer size defined. Please contribute to this library!"
@@ -78,6 +83,8 @@ public:
   void read(uint32_t eepromLocation, uint8_t *buff, uint16_t bufferSize);
   void write(uint32_t eepromLocation, uint8_t dataToWrite);
   void write(uint32_t eepromLocation, const uint8_t *dataToWrite, uint16_t blockSize);
+  bool writePage(uint32_t eepromLocation, const uint8_t *dataToWrite, uint16_t blockSize); //Single page in one transaction
+  bool waitForWriteComplete(uint8_t i2cAddress = 255); //ACK polling, gives up after 2x pageWriteTime_ms
 
   bool begin(uint8_t deviceAddress = 0b1010000, TwoWire &wirePort = Wire); //By default use the Wire port
   bool isConnected(uint8_t i2cAddress = 255);
@@ -122,6 +129,7 @@ private:
       .pageSize_bytes = 64,
       .pageWriteTime_ms = 5,
       .pollForWriteComplete = true,
+      .i2cBufferSize = I2C_BUFFER_LENGTH_TX,
   };
 };
 
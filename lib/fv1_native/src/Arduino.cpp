@@ -0,0 +1,275 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Arduino.h"
+#include "fv1_native.h"
+#include <stdio.h>
+#include <vector>
+
+#define GPIO_PINS           (16u)
+#define GPIO_PIN_MASK       ((1u << GPIO_PINS) - 1)
+
+native_cpu_t native_cpu =
+{
+    .cpu_mhz = 80,
+    .free_heap = 40000,
+    .gpio_read_cycles = 12,
+    .gpio_write_cycles = 4,
+    .cycle_count_cycles = 2,
+    .wdt_feed_cycles = 12,
+};
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static uint64_t time_ps = 0;        // picoseconds, whole CPU cycles at 80 and 160 MHz
+static uint32_t gpio_out = 0;       // GPO
+static uint32_t gpio_enable = 0;    // GPE
+static std::vector<NativeGpioDevice *> gpio_devices;
+
+static void gpio_run(void);
+
+// -----------------------------------------------------------------------------------------------------
+uint64_t native_time_ns(void)
+{
+    return time_ps / 1000u;
+}
+// -----------------------------------------------------------------------------------------------------
+void native_advance_ns(uint64_t ns)
+{
+    time_ps += ns * 1000u;
+}
+// -----------------------------------------------------------------------------------------------------
+void native_advance_cycles(uint32_t cycles)
+{
+    time_ps += (uint64_t)cycles * 1000000u / native_cpu.cpu_mhz;
+}
+// -----------------------------------------------------------------------------------------------------
+void native_gpio_attach(NativeGpioDevice *dev)
+{
+    gpio_devices.push_back(dev);
+}
+// -----------------------------------------------------------------------------------------------------
+void native_gpio_detach(NativeGpioDevice *dev)
+{
+    gpio_devices.erase(std::remove(gpio_devices.begin(), gpio_devices.end(), dev), gpio_devices.end());
+}
+// -----------------------------------------------------------------------------------------------------
+uint32_t native_gpio_levels(void)
+{
+    // open drain bus with pull-ups: a pin is low if its output is enabled with a low latch
+    // or a model holds it low
+    uint32_t low = gpio_enable & ~gpio_out;
+    for (auto dev : gpio_devices)
+        low |= dev->get_pull_low();
+    return ~low & GPIO_PIN_MASK;
+}
+// -----------------------------------------------------------------------------------------------------
+uint32_t native_gpio_read(uint32_t addr)
+{
+    native_advance_cycles(native_cpu.gpio_read_cycles);
+    gpio_run();
+    switch (addr)
+    {
+    case 0x300:
+        return gpio_out;
+    case 0x30C:
+        return gpio_enable;
+    case 0x318:
+        return native_gpio_levels();
+    default:
+        return 0;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void native_gpio_write(uint32_t addr, uint32_t value)
+{
+    native_advance_cycles(native_cpu.gpio_write_cycles);
+    gpio_run();
+    value &= GPIO_PIN_MASK;
+    switch (addr)
+    {
+    case 0x300: gpio_out = value;           break;
+    case 0x304: gpio_out |= value;          break;
+    case 0x308: gpio_out &= ~value;         break;
+    case 0x30C: gpio_enable = value;        break;
+    case 0x310: gpio_enable |= value;       break;
+    case 0x314: gpio_enable &= ~value;      break;
+    default:                                return;
+    }
+    for (auto dev : gpio_devices)
+        dev->changed(native_time_ns());
+}
+// -----------------------------------------------------------------------------------------------------
+static void gpio_run(void)
+{
+    for (auto dev : gpio_devices)
+        dev->run(native_time_ns());
+}
+// -----------------------------------------------------------------------------------------------------
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if (pin >= GPIO_PINS)
+        return;
+    if (mode == OUTPUT || mode == OUTPUT_OPEN_DRAIN)
+        GPES = 1 << pin;
+    else
+        GPEC = 1 << pin;
+}
+// -----------------------------------------------------------------------------------------------------
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin >= GPIO_PINS)
+        return;
+    if (value)
+        GPOS = 1 << pin;
+    else
+        GPOC = 1 << pin;
+}
+// -----------------------------------------------------------------------------------------------------
+int digitalRead(uint8_t pin)
+{
+    if (pin >= GPIO_PINS)
+        return LOW;
+    return (GPI >> pin) & 1;
+}
+// -----------------------------------------------------------------------------------------------------
+unsigned long millis(void)
+{
+    return time_ps / 1000000000u;
+}
+// -----------------------------------------------------------------------------------------------------
+unsigned long micros(void)
+{
+    return time_ps / 1000000u;
+}
+// -----------------------------------------------------------------------------------------------------
+void delay(unsigned long ms)
+{
+    time_ps += (uint64_t)ms * 1000000000u;
+    gpio_run();
+}
+// -----------------------------------------------------------------------------------------------------
+void delayMicroseconds(unsigned int us)
+{
+    time_ps += (uint64_t)us * 1000000u;
+    gpio_run();
+}
+// -----------------------------------------------------------------------------------------------------
+void yield(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = min(len, size - 1);
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+// -----------------------------------------------------------------------------------------------------
+uint32_t EspClass::getCycleCount(void)
+{
+    native_advance_cycles(native_cpu.cycle_count_cycles);
+    // split at whole microseconds, time_ps * cpu_mhz would overflow after a few minutes
+    return (uint32_t)(time_ps / 1000000u * native_cpu.cpu_mhz + time_ps % 1000000u * native_cpu.cpu_mhz / 1000000u);
+}
+// -----------------------------------------------------------------------------------------------------
+uint8_t EspClass::getCpuFreqMHz(void)
+{
+    return native_cpu.cpu_mhz;
+}
+// -----------------------------------------------------------------------------------------------------
+uint32_t EspClass::getFreeHeap(void)
+{
+    return native_cpu.free_heap;
+}
+// -----------------------------------------------------------------------------------------------------
+void EspClass::wdtFeed(void)
+{
+    native_advance_cycles(native_cpu.wdt_feed_cycles);
+}
+// -----------------------------------------------------------------------------------------------------
+size_t Print::write(const uint8_t *buf, size_t size)
+{
+    size_t n = 0;
+    while (size--)
+        n += write(*buf++);
+    return n;
+}
+// -----------------------------------------------------------------------------------------------------
+size_t Print::printf(const char *format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0)
+        return 0;
+    return write((const uint8_t *)buf, min((size_t)len, sizeof(buf) - 1));
+}
+// -----------------------------------------------------------------------------------------------------
+size_t Print::print(long value, int base)
+{
+    if (base == DEC && value < 0)
+        return print('-') + print(-(unsigned long)value, base);
+    return print((unsigned long)value, base);
+}
+// -----------------------------------------------------------------------------------------------------
+size_t Print::print(unsigned long value, int base)
+{
+    // upper case digits like the core's printNumber()
+    String num(value, base);
+    num.toUpperCase();
+    return print(num);
+}
+// -----------------------------------------------------------------------------------------------------
+size_t Print::print(double value, int digits)
+{
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", digits, value);
+    return print(buf);
+}
+// -----------------------------------------------------------------------------------------------------
+String Stream::readString(void)
+{
+    String res;
+    int c;
+    while ((c = read()) >= 0)
+        res += (char)c;
+    return res;
+}
+// -----------------------------------------------------------------------------------------------------
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+// -----------------------------------------------------------------------------------------------------
+size_t HardwareSerial::write(const uint8_t *buf, size_t size)
+{
+    // quiet unless asked for, keeps the test and benchmark output readable
+    static const bool verbose = getenv("FV1_NATIVE_VERBOSE") != NULL;
+    if (verbose)
+        fwrite(buf, 1, size, stdout);
+    return size;
+}
@@ -0,0 +1,139 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_NATIVE_ARDUINO_H
+#define _FV1_NATIVE_ARDUINO_H
+
+// Linux stand-in for the parts of the ESP8266 Arduino core used by the FV1 class.
+// Time is virtual, see fv1_native.h for the clock, the GPIO register file and the test controls.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include "WString.h"
+#include "esp8266_peri.h"
+
+using std::min;
+using std::max;
+
+// in the newlib of the ESP8266, glibc has it from 2.38 on
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t size);
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH                0x1
+#define LOW                 0x0
+
+#define INPUT               0x00
+#define INPUT_PULLUP        0x02
+#define OUTPUT              0x01
+#define OUTPUT_OPEN_DRAIN   0x03
+
+#define DEC                 10
+#define HEX                 16
+#define OCT                 8
+#define BIN                 2
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define PSTR(s)             (s)
+#define F(s)                (s)
+
+static const uint8_t SDA = 4;
+static const uint8_t SCL = 5;
+static const uint8_t LED_BUILTIN = 2;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+static inline void noInterrupts(void) {}
+static inline void interrupts(void) {}
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size);
+    size_t write(const char *str) {return write((const uint8_t *)str, strlen(str));}
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char *str) {return write(str);}
+    size_t print(const String &str) {return write(str.c_str());}
+    size_t print(char c) {return write((uint8_t)c);}
+    size_t print(unsigned char value, int base = DEC) {return print((unsigned long)value, base);}
+    size_t print(int value, int base = DEC) {return print((long)value, base);}
+    size_t print(unsigned int value, int base = DEC) {return print((unsigned long)value, base);}
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t println(void) {return write("\r\n");}
+    template <typename T> size_t println(const T &value) {size_t n = print(value); return n + println();}
+    template <typename T> size_t println(const T &value, int base) {size_t n = print(value, base); return n + println();}
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+    String readString(void);
+};
+
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long baud) {(void)baud;}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+    int available(void) override {return 0;}
+    int read(void) override {return -1;}
+    int peek(void) override {return -1;}
+};
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+    uint32_t getCycleCount(void);
+    uint8_t getCpuFreqMHz(void);
+    uint32_t getFreeHeap(void);
+    void wdtFeed(void);
+    void restart(void) {}
+};
+
+extern EspClass ESP;
+
+#endif // _FV1_NATIVE_ARDUINO_H
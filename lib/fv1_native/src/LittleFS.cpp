@@ -0,0 +1,400 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "LittleFS.h"
+#include "fv1_native.h"
+#include <stdio.h>
+
+FS LittleFS;
+
+static String norm_path(const String &path);
+static String parent_path(const String &path);
+static time_t fs_time(void);
+
+// -----------------------------------------------------------------------------------------------------
+File::File(const String &path, std::shared_ptr<native_file_t> node, bool write, bool dir)
+{
+    this->path = path;
+    this->node = node;
+    writable = write;
+    this->dir = dir;
+}
+// -----------------------------------------------------------------------------------------------------
+size_t File::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+// -----------------------------------------------------------------------------------------------------
+size_t File::write(const uint8_t *buf, size_t size)
+{
+    if (!node || !writable)
+        return 0;
+    if (pos + size > node->data.size())
+        node->data.resize(pos + size);
+    memcpy(&node->data[pos], buf, size);
+    pos += size;
+    node->mtime = fs_time();
+    return size;
+}
+// -----------------------------------------------------------------------------------------------------
+int File::available(void)
+{
+    return node ? node->data.size() - pos : 0;
+}
+// -----------------------------------------------------------------------------------------------------
+int File::read(void)
+{
+    if (!node || pos >= node->data.size())
+        return -1;
+    return node->data[pos++];
+}
+// -----------------------------------------------------------------------------------------------------
+int File::peek(void)
+{
+    if (!node || pos >= node->data.size())
+        return -1;
+    return node->data[pos];
+}
+// -----------------------------------------------------------------------------------------------------
+size_t File::read(uint8_t *buf, size_t size)
+{
+    if (!node || pos >= node->data.size())
+        return 0;
+    size = min(size, node->data.size() - pos);
+    memcpy(buf, &node->data[pos], size);
+    pos += size;
+    return size;
+}
+// -----------------------------------------------------------------------------------------------------
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+    if (!node)
+        return false;
+    size_t base = mode == SeekSet ? 0 : mode == SeekCur ? this->pos : node->data.size();
+    if (base + pos > node->data.size())
+        return false;
+    this->pos = base + pos;
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+size_t File::size(void) const
+{
+    return node ? node->data.size() : 0;
+}
+// -----------------------------------------------------------------------------------------------------
+void File::close(void)
+{
+    node.reset();
+    dir = false;
+}
+// -----------------------------------------------------------------------------------------------------
+const char *File::name(void) const
+{
+    const char *slash = strrchr(path.c_str(), '/');
+    return slash ? slash + 1 : path.c_str();
+}
+// -----------------------------------------------------------------------------------------------------
+bool Dir::next(void)
+{
+    if (!fs || done)
+        return false;
+    String after = name;
+    done = !fs->next_child(path, after, name);
+    if (done)
+        name = "";
+    return !done;
+}
+// -----------------------------------------------------------------------------------------------------
+size_t Dir::fileSize(void)
+{
+    return openFile("r").size();
+}
+// -----------------------------------------------------------------------------------------------------
+time_t Dir::fileTime(void)
+{
+    return openFile("r").getLastWrite();
+}
+// -----------------------------------------------------------------------------------------------------
+bool Dir::isFile(void)
+{
+    return openFile("r").isFile();
+}
+// -----------------------------------------------------------------------------------------------------
+bool Dir::isDirectory(void)
+{
+    return openFile("r").isDirectory();
+}
+// -----------------------------------------------------------------------------------------------------
+File Dir::openFile(const char *mode)
+{
+    return fs && name.length() ? fs->open(child(), mode) : File();
+}
+// -----------------------------------------------------------------------------------------------------
+String Dir::child(void) const
+{
+    return (path == "/" ? path : path + "/") + name;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::format(void)
+{
+    files.clear();
+    dirs.clear();
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::info(FSInfo &info)
+{
+    memset(&info, 0, sizeof(info));
+    info.totalBytes = NATIVE_FS_TOTAL_BYTES;
+    info.blockSize = NATIVE_FS_BLOCK_SIZE;
+    info.pageSize = 256;
+    info.maxOpenFiles = 5;
+    info.maxPathLength = 32;
+    info.usedBytes = 2 * NATIVE_FS_BLOCK_SIZE;
+    for (auto &f : files)
+        info.usedBytes += (f.second->data.size() + NATIVE_FS_BLOCK_SIZE - 1) / NATIVE_FS_BLOCK_SIZE * NATIVE_FS_BLOCK_SIZE;
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+File FS::open(const String &path, const char *mode)
+{
+    String p = norm_path(path);
+    auto f = files.find(p);
+    bool update = strchr(mode, '+') != NULL;
+
+    if (!path.length())
+        return File();
+    if (mode[0] == 'r')
+    {
+        if (f != files.end())
+            return File(p, f->second, update);
+        if (is_dir(p))
+            return File(p, NULL, false, true);
+        return File();
+    }
+    if ((mode[0] != 'w' && mode[0] != 'a') || is_dir(p))
+        return File();
+    if (f == files.end())
+    {
+        f = files.emplace(p, std::make_shared<native_file_t>()).first;
+        f->second->mtime = fs_time();
+        add_parents(p);
+    }
+    if (mode[0] == 'w')
+    {
+        f->second->data.clear();
+        f->second->mtime = fs_time();
+    }
+    File file(p, f->second, true);
+    if (mode[0] == 'a')
+        file.seek(0, SeekEnd);
+    return file;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::exists(const String &path)
+{
+    String p = norm_path(path);
+    return path.length() && (files.count(p) || is_dir(p));
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::remove(const String &path)
+{
+    String p = norm_path(path);
+    if (!files.erase(p))
+        return false;
+    drop_parents(p);
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::rename(const String &from, const String &to)
+{
+    String src = norm_path(from);
+    String dst = norm_path(to);
+    auto f = files.find(src);
+    if (f != files.end())
+    {
+        auto node = f->second;
+        files.erase(f);
+        files[dst] = node;
+        add_parents(dst);
+        drop_parents(src);
+        return true;
+    }
+    if (!is_dir(src) || src == "/" || exists(dst))
+        return false;
+    // folder: move everything below it
+    String prefix = src + "/";
+    std::map<String, std::shared_ptr<native_file_t>> moved;
+    for (auto it = files.begin(); it != files.end();)
+    {
+        if (it->first.startsWith(prefix))
+        {
+            moved[dst + it->first.substring(src.length())] = it->second;
+            it = files.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+    std::set<String> moved_dirs;
+    for (auto it = dirs.begin(); it != dirs.end();)
+    {
+        if (*it == src || it->startsWith(prefix))
+        {
+            moved_dirs.insert(dst + it->substring(src.length()));
+            it = dirs.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+    files.insert(moved.begin(), moved.end());
+    dirs.insert(moved_dirs.begin(), moved_dirs.end());
+    add_parents(dst);
+    drop_parents(src);
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::mkdir(const String &path)
+{
+    String p = norm_path(path);
+    if (files.count(p))
+        return false;
+    add_parents(p);
+    if (p != "/")
+        dirs.insert(p);
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::rmdir(const String &path)
+{
+    String p = norm_path(path);
+    if (!dirs.count(p) || has_children(p))
+        return false;
+    dirs.erase(p);
+    drop_parents(p);
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+Dir FS::openDir(const String &path)
+{
+    String p = norm_path(path);
+
+    if (!is_dir(p))
+        return Dir();
+    return Dir(this, p);
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::is_dir(const String &path)
+{
+    return path == "/" || dirs.count(path);
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::has_children(const String &path)
+{
+    String prefix = path + "/";
+    for (auto &f : files)
+    {
+        if (f.first.startsWith(prefix))
+            return true;
+    }
+    for (auto &d : dirs)
+    {
+        if (d.startsWith(prefix))
+            return true;
+    }
+    return false;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FS::next_child(const String &path, const String &after, String &name)
+{
+    // first file or folder directly in path sorting after "after", the entries below it are skipped
+    String prefix = path == "/" ? path : path + "/";
+    String from = prefix + after;
+    bool found = false;
+
+    for (auto f = files.upper_bound(from); f != files.end() && f->first.startsWith(prefix); f++)
+    {
+        if (f->first.indexOf('/', prefix.length()) < 0)
+        {
+            name = f->first.substring(prefix.length());
+            found = true;
+            break;
+        }
+    }
+    for (auto d = dirs.upper_bound(from); d != dirs.end() && d->startsWith(prefix); d++)
+    {
+        if (d->indexOf('/', prefix.length()) < 0)
+        {
+            String n = d->substring(prefix.length());
+            if (!found || n < name)
+                name = n;
+            found = true;
+            break;
+        }
+    }
+    return found;
+}
+// -----------------------------------------------------------------------------------------------------
+void FS::add_parents(const String &path)
+{
+    for (String p = parent_path(path); p != "/"; p = parent_path(p))
+        dirs.insert(p);
+}
+// -----------------------------------------------------------------------------------------------------
+void FS::drop_parents(const String &path)
+{
+    for (String p = parent_path(path); p != "/" && !has_children(p); p = parent_path(p))
+        dirs.erase(p);
+}
+// -----------------------------------------------------------------------------------------------------
+bool native_fs_load(FS &fs, const char *host_path, const String &path)
+{
+    uint8_t buf[4096];
+    FILE *src = fopen(host_path, "rb");
+    if (!src)
+        return false;
+    File dst = fs.open(path, "w");
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), src)) > 0)
+        dst.write(buf, len);
+    fclose(src);
+    dst.close();
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+static String norm_path(const String &path)
+{
+    String p = path.startsWith("/") ? path : "/" + path;
+    while (p.indexOf("//") >= 0)    // LittleFS skips repeated separators
+        p.replace("//", "/");
+    while (p.length() > 1 && p.endsWith("/"))
+        p.remove(p.length() - 1);
+    return p;
+}
+// -----------------------------------------------------------------------------------------------------
+static String parent_path(const String &path)
+{
+    int slash = path.lastIndexOf('/');
+    return slash > 0 ? path.substring(0, slash) : String("/");
+}
+// -----------------------------------------------------------------------------------------------------
+static time_t fs_time(void)
+{
+    return NATIVE_FS_EPOCH + millis() / 1000u;
+}
@@ -0,0 +1,139 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_NATIVE_LITTLEFS_H
+#define _FV1_NATIVE_LITTLEFS_H
+
+// In-memory LittleFS for the native build. Same folder rules as the ESP8266 one:
+// writing a file creates its folders, removing the last file of a folder removes it.
+// The write time comes from the virtual clock. A directory is read one entry at a
+// time, the names are not copied aside.
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#define NATIVE_FS_TOTAL_BYTES   (3u * 1024u * 1024u)
+#define NATIVE_FS_BLOCK_SIZE    (8192u)
+#define NATIVE_FS_EPOCH         (1609459200u)   // virtual clock start, 2021-01-01
+
+enum SeekMode
+{
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+struct FSInfo
+{
+    size_t totalBytes;
+    size_t usedBytes;
+    size_t blockSize;
+    size_t pageSize;
+    size_t maxOpenFiles;
+    size_t maxPathLength;
+};
+
+typedef struct
+{
+    std::vector<uint8_t> data;
+    time_t mtime;
+}native_file_t;
+
+class File : public Stream
+{
+public:
+    File() {}
+    File(const String &path, std::shared_ptr<native_file_t> node, bool write, bool dir = false);
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+    int available(void) override;
+    int read(void) override;
+    int peek(void) override;
+    size_t read(uint8_t *buf, size_t size);
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position(void) const {return pos;}
+    size_t size(void) const;
+    void flush(void) {}
+    void close(void);
+    operator bool() const {return node || dir;}
+    const char *name(void) const;
+    const char *fullName(void) const {return path.c_str();}
+    bool isFile(void) const {return (bool)node;}
+    bool isDirectory(void) const {return dir;}
+    time_t getLastWrite(void) const {return node ? node->mtime : 0;}
+private:
+    String path;
+    std::shared_ptr<native_file_t> node;
+    bool writable = false;
+    bool dir = false;
+    size_t pos = 0;
+};
+
+class FS;
+
+class Dir
+{
+public:
+    Dir() {}
+    Dir(FS *fs, const String &path) : fs(fs), path(path) {}
+    bool next(void);
+    String fileName(void) const {return name;}
+    size_t fileSize(void);
+    time_t fileTime(void);
+    bool isFile(void);
+    bool isDirectory(void);
+    File openFile(const char *mode);
+private:
+    FS *fs = NULL;
+    String path;
+    String name;        // current entry, empty before the first next()
+    bool done = false;
+    String child(void) const;
+};
+
+class FS
+{
+    friend class Dir;
+public:
+    bool begin(void) {return true;}
+    void end(void) {}
+    bool format(void);
+    bool info(FSInfo &info);
+    File open(const String &path, const char *mode);
+    bool exists(const String &path);
+    bool remove(const String &path);
+    bool rename(const String &from, const String &to);
+    bool mkdir(const String &path);
+    bool rmdir(const String &path);
+    Dir openDir(const String &path);
+private:
+    std::map<String, std::shared_ptr<native_file_t>> files;
+    std::set<String> dirs;
+    bool is_dir(const String &path);
+    bool has_children(const String &path);
+    bool next_child(const String &path, const String &after, String &name);
+    void add_parents(const String &path);
+    void drop_parents(const String &path);
+};
+
+extern FS LittleFS;
+
+#endif // _FV1_NATIVE_LITTLEFS_H
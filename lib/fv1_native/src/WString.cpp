@@ -0,0 +1,178 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "WString.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <strings.h>
+
+static std::string format_number(unsigned long value, bool negative, unsigned char base);
+
+// -----------------------------------------------------------------------------------------------------
+String::String(int value, unsigned char base) : String((long)value, base)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+String::String(unsigned int value, unsigned char base) : String((unsigned long)value, base)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+String::String(long value, unsigned char base)
+{
+    // like the core, only base 10 prints a sign
+    if (base == 10 && value < 0)
+        s = format_number(-(unsigned long)value, true, base);
+    else
+        s = format_number((unsigned long)value, false, base);
+}
+// -----------------------------------------------------------------------------------------------------
+String::String(unsigned long value, unsigned char base)
+{
+    s = format_number(value, false, base);
+}
+// -----------------------------------------------------------------------------------------------------
+bool String::equalsIgnoreCase(const String &str) const
+{
+    return s.length() == str.s.length() && !strcasecmp(s.c_str(), str.s.c_str());
+}
+// -----------------------------------------------------------------------------------------------------
+bool String::endsWith(const String &suffix) const
+{
+    return s.length() >= suffix.s.length() && !s.compare(s.length() - suffix.s.length(), suffix.s.length(), suffix.s);
+}
+// -----------------------------------------------------------------------------------------------------
+int String::indexOf(char c, unsigned int from) const
+{
+    size_t pos = s.find(c, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+// -----------------------------------------------------------------------------------------------------
+int String::indexOf(const String &str, unsigned int from) const
+{
+    size_t pos = s.find(str.s, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+// -----------------------------------------------------------------------------------------------------
+int String::lastIndexOf(char c) const
+{
+    size_t pos = s.rfind(c);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+// -----------------------------------------------------------------------------------------------------
+String String::substring(unsigned int from, unsigned int to) const
+{
+    if (from > to)
+    {
+        unsigned int tmp = from;
+        from = to;
+        to = tmp;
+    }
+    if (from >= s.length())
+        return String();
+    if (to > s.length())
+        to = s.length();
+    return String(s.substr(from, to - from));
+}
+// -----------------------------------------------------------------------------------------------------
+void String::remove(unsigned int index, unsigned int count)
+{
+    if (index < s.length())
+        s.erase(index, count);
+}
+// -----------------------------------------------------------------------------------------------------
+void String::replace(const String &find, const String &with)
+{
+    if (find.s.empty())
+        return;
+    size_t pos = 0;
+    while ((pos = s.find(find.s, pos)) != std::string::npos)
+    {
+        s.replace(pos, find.s.length(), with.s);
+        pos += with.s.length();
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void String::toLowerCase(void)
+{
+    for (auto &c : s)
+        c = tolower((unsigned char)c);
+}
+// -----------------------------------------------------------------------------------------------------
+void String::toUpperCase(void)
+{
+    for (auto &c : s)
+        c = toupper((unsigned char)c);
+}
+// -----------------------------------------------------------------------------------------------------
+void String::trim(void)
+{
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+    {
+        s.clear();
+        return;
+    }
+    s = s.substr(begin, s.find_last_not_of(" \t\r\n") - begin + 1);
+}
+// -----------------------------------------------------------------------------------------------------
+long String::toInt(void) const
+{
+    return atol(s.c_str());
+}
+// -----------------------------------------------------------------------------------------------------
+String operator+(const String &lhs, const String &rhs)
+{
+    String res = lhs;
+    res += rhs;
+    return res;
+}
+// -----------------------------------------------------------------------------------------------------
+String operator+(const String &lhs, const char *rhs)
+{
+    String res = lhs;
+    res += rhs;
+    return res;
+}
+// -----------------------------------------------------------------------------------------------------
+String operator+(const char *lhs, const String &rhs)
+{
+    String res = lhs;
+    res += rhs;
+    return res;
+}
+// -----------------------------------------------------------------------------------------------------
+String operator+(const String &lhs, char rhs)
+{
+    String res = lhs;
+    res += rhs;
+    return res;
+}
+// -----------------------------------------------------------------------------------------------------
+static std::string format_number(unsigned long value, bool negative, unsigned char base)
+{
+    std::string res;
+    if (base < 2 || base > 36)
+        base = 10;
+    do
+    {
+        uint8_t digit = value % base;
+        res.insert(res.begin(), digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value);
+    if (negative)
+        res.insert(res.begin(), '-');
+    return res;
+}
@@ -0,0 +1,90 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_NATIVE_WSTRING_H
+#define _FV1_NATIVE_WSTRING_H
+
+// Arduino String for the native build, the subset used by the project on top of std::string.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+class String
+{
+public:
+    String() {}
+    String(const char *cstr) : s(cstr ? cstr : "") {}
+    String(const std::string &str) : s(str) {}
+    explicit String(char c) : s(1, c) {}
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+
+    unsigned int length(void) const {return s.length();}
+    bool isEmpty(void) const {return s.empty();}
+    const char *c_str(void) const {return s.c_str();}
+    bool reserve(unsigned int size) {s.reserve(size); return true;}
+
+    String &operator+=(const String &rhs) {s += rhs.s; return *this;}
+    String &operator+=(const char *cstr) {s += cstr ? cstr : ""; return *this;}
+    String &operator+=(char c) {s += c; return *this;}
+    String &operator+=(int value) {return *this += String(value);}
+    String &operator+=(unsigned int value) {return *this += String(value);}
+    String &operator+=(long value) {return *this += String(value);}
+    String &operator+=(unsigned long value) {return *this += String(value);}
+    bool concat(const String &str) {*this += str; return true;}
+    bool concat(const char *cstr) {*this += cstr; return true;}
+    bool concat(char c) {*this += c; return true;}
+
+    bool operator==(const String &rhs) const {return s == rhs.s;}
+    bool operator==(const char *cstr) const {return s == (cstr ? cstr : "");}
+    bool operator!=(const String &rhs) const {return s != rhs.s;}
+    bool operator!=(const char *cstr) const {return !(*this == cstr);}
+    bool operator<(const String &rhs) const {return s < rhs.s;}
+    bool equals(const String &str) const {return s == str.s;}
+    bool equalsIgnoreCase(const String &str) const;
+    bool startsWith(const String &prefix) const {return s.compare(0, prefix.s.length(), prefix.s) == 0;}
+    bool endsWith(const String &suffix) const;
+
+    char charAt(unsigned int index) const {return index < s.length() ? s[index] : 0;}
+    char operator[](unsigned int index) const {return charAt(index);}
+    char &operator[](unsigned int index) {return s[index];}
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String &str, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    String substring(unsigned int from) const {return substring(from, s.length());}
+    String substring(unsigned int from, unsigned int to) const;
+
+    void remove(unsigned int index) {remove(index, (unsigned int)-1);}
+    void remove(unsigned int index, unsigned int count);
+    void replace(const String &find, const String &with);
+    void toLowerCase(void);
+    void toUpperCase(void);
+    void trim(void);
+    long toInt(void) const;
+private:
+    std::string s;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+
+#endif // _FV1_NATIVE_WSTRING_H
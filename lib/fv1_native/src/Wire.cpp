@@ -0,0 +1,124 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Wire.h"
+#include "fv1_native.h"
+
+TwoWire Wire;
+
+// -----------------------------------------------------------------------------------------------------
+void TwoWire::beginTransmission(uint8_t address)
+{
+    tx_addr = address;
+    tx_len = 0;
+    tx_overflow = false;
+}
+// -----------------------------------------------------------------------------------------------------
+uint8_t TwoWire::endTransmission(uint8_t sendStop)
+{
+    // same result codes as the ESP8266 core: 0 ok, 1 buffer overflow, 2 address NACK, 3 data NACK
+    NativeI2CDevice *dev = find(tx_addr);
+    size_t sent = 0;
+    uint8_t result = 0;
+
+    if (tx_overflow)
+        return 1;
+    if (!dev || !dev->start(false))
+    {
+        result = 2;
+    }
+    else
+    {
+        while (sent < tx_len && dev->write(tx_buf[sent]))
+            sent++;
+        if (sent < tx_len)
+            result = 3;
+    }
+    bus_time(1 + sent + (result == 3));
+    if (dev && (sendStop || result))
+        dev->stop();
+    tx_len = 0;
+    return result;
+}
+// -----------------------------------------------------------------------------------------------------
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop)
+{
+    NativeI2CDevice *dev = find(address);
+
+    rx_len = 0;
+    rx_pos = 0;
+    if (quantity > BUFFER_LENGTH)
+        quantity = BUFFER_LENGTH;
+    if (!dev || !dev->start(true))
+    {
+        bus_time(1);
+        if (dev)
+            dev->stop();
+        return 0;
+    }
+    while (rx_len < quantity)
+        rx_buf[rx_len++] = dev->read();
+    bus_time(1 + quantity);
+    if (sendStop)
+        dev->stop();
+    return rx_len;
+}
+// -----------------------------------------------------------------------------------------------------
+size_t TwoWire::write(uint8_t data)
+{
+    if (tx_len >= BUFFER_LENGTH)
+    {
+        tx_overflow = true;
+        return 0;
+    }
+    tx_buf[tx_len++] = data;
+    return 1;
+}
+// -----------------------------------------------------------------------------------------------------
+size_t TwoWire::write(const uint8_t *data, size_t quantity)
+{
+    size_t n = 0;
+    while (n < quantity && write(data[n]))
+        n++;
+    return n;
+}
+// -----------------------------------------------------------------------------------------------------
+void TwoWire::attach(NativeI2CDevice *dev)
+{
+    devices.push_back(dev);
+}
+// -----------------------------------------------------------------------------------------------------
+void TwoWire::detach(NativeI2CDevice *dev)
+{
+    devices.erase(std::remove(devices.begin(), devices.end(), dev), devices.end());
+}
+// -----------------------------------------------------------------------------------------------------
+NativeI2CDevice *TwoWire::find(uint8_t address)
+{
+    for (auto dev : devices)
+    {
+        if (dev->get_address() == address)
+            return dev;
+    }
+    return NULL;
+}
+// -----------------------------------------------------------------------------------------------------
+void TwoWire::bus_time(uint32_t bytes)
+{
+    // start, 9 clocks per byte, stop
+    uint64_t bits = 9u * bytes + 2u;
+    native_advance_ns(bits * 1000000000u / clock_hz);
+}
@@ -0,0 +1,79 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_NATIVE_WIRE_H
+#define _FV1_NATIVE_WIRE_H
+
+// I2C master of the native build with the ESP8266 TwoWire interface and buffer size.
+// Transactions are passed to the device models attached at their address, a missing
+// device does not acknowledge. Every transfer adds its bit time to the virtual clock.
+
+#include <Arduino.h>
+#include <vector>
+
+#define BUFFER_LENGTH       128
+
+// Device on the bus, called once per I2C event of a transaction addressed to it.
+class NativeI2CDevice
+{
+public:
+    NativeI2CDevice(uint8_t address) : address(address) {}
+    virtual ~NativeI2CDevice() {}
+    uint8_t get_address(void) {return address;}
+    virtual bool start(bool read) = 0;      // (repeated) start and address byte, true = ACK
+    virtual bool write(uint8_t data) = 0;   // true = ACK
+    virtual uint8_t read(void) = 0;
+    virtual void stop(void) = 0;
+protected:
+    uint8_t address;
+};
+
+class TwoWire
+{
+public:
+    void begin(void) {}
+    void begin(int sda, int scl) {(void)sda; (void)scl;}
+    void setClock(uint32_t hz) {clock_hz = hz;}
+    void setClockStretchLimit(uint32_t limit) {(void)limit;}
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(uint8_t sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop = true);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t quantity);
+    int available(void) {return rx_len - rx_pos;}
+    int read(void) {return rx_pos < rx_len ? rx_buf[rx_pos++] : -1;}
+    int peek(void) {return rx_pos < rx_len ? rx_buf[rx_pos] : -1;}
+    void flush(void) {}
+    void attach(NativeI2CDevice *dev);
+    void detach(NativeI2CDevice *dev);
+private:
+    uint32_t clock_hz = 100000;
+    std::vector<NativeI2CDevice *> devices;
+    uint8_t tx_addr = 0;
+    uint8_t tx_buf[BUFFER_LENGTH];
+    size_t tx_len = 0;
+    bool tx_overflow = false;
+    uint8_t rx_buf[BUFFER_LENGTH];
+    size_t rx_len = 0;
+    size_t rx_pos = 0;
+    NativeI2CDevice *find(uint8_t address);
+    void bus_time(uint32_t bytes);
+};
+
+extern TwoWire Wire;
+
+#endif // _FV1_NATIVE_WIRE_H
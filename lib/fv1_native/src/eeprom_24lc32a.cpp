@@ -0,0 +1,119 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "eeprom_24lc32a.h"
+#include "fv1_native.h"
+
+// -----------------------------------------------------------------------------------------------------
+Eeprom24LC32A::Eeprom24LC32A(uint8_t address) : NativeI2CDevice(address)
+{
+    erase();
+}
+// -----------------------------------------------------------------------------------------------------
+bool Eeprom24LC32A::start(bool read)
+{
+    if (!present)
+        return false;
+    if (busy())
+    {
+        busy_nacks++;
+        return false;
+    }
+    // a repeated start drops a page that was not ended with a stop
+    page_loaded = 0;
+    addr_bytes = 0;
+    reading = read;
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+bool Eeprom24LC32A::write(uint8_t data)
+{
+    if (!present || reading)
+        return false;
+    switch (addr_bytes)
+    {
+    case 0:
+        ptr = (data << 8) & (EEP_24LC32A_SIZE - 1);
+        addr_bytes++;
+        break;
+    case 1:
+        ptr |= data;
+        page_addr = ptr & ~(EEP_24LC32A_PAGE_SIZE - 1);
+        addr_bytes++;
+        break;
+    default:
+        // the address counter wraps inside the page
+        page_buf[ptr % EEP_24LC32A_PAGE_SIZE] = data;
+        page_loaded |= 1u << (ptr % EEP_24LC32A_PAGE_SIZE);
+        ptr = page_addr | ((ptr + 1) % EEP_24LC32A_PAGE_SIZE);
+        break;
+    }
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+uint8_t Eeprom24LC32A::read(void)
+{
+    if (!present || !reading)
+        return 0xFF;    // released bus
+    uint8_t value = mem[ptr];
+    ptr = (ptr + 1) % EEP_24LC32A_SIZE;
+    bytes_read++;
+    return value;
+}
+// -----------------------------------------------------------------------------------------------------
+void Eeprom24LC32A::stop(void)
+{
+    reading = false;
+    if (!present || !page_loaded)
+        return;
+    // only the loaded bytes of the page are stored
+    bool flipped = false;
+    for (uint8_t i = 0; i < EEP_24LC32A_PAGE_SIZE; i++)
+    {
+        if (!(page_loaded & (1u << i)))
+            continue;
+        uint16_t addr = page_addr + i;
+        mem[addr] = page_buf[i];
+        if (flip_count && addr == flip_addr)
+        {
+            mem[addr] ^= flip_mask;
+            flipped = true;
+        }
+    }
+    if (flipped)
+        flip_count--;
+    page_loaded = 0;
+    write_cycles++;
+    busy_until_ns = stuck ? UINT64_MAX : native_time_ns() + (uint64_t)write_us * 1000u;
+}
+// -----------------------------------------------------------------------------------------------------
+bool Eeprom24LC32A::busy(void)
+{
+    return native_time_ns() < busy_until_ns;
+}
+// -----------------------------------------------------------------------------------------------------
+void Eeprom24LC32A::erase(uint8_t value)
+{
+    memset(mem, value, sizeof(mem));
+}
+// -----------------------------------------------------------------------------------------------------
+void Eeprom24LC32A::set_bit_flip(uint16_t addr, uint8_t mask, uint32_t count)
+{
+    // the next count write cycles covering addr store it with the mask bits inverted
+    flip_addr = addr % EEP_24LC32A_SIZE;
+    flip_mask = mask;
+    flip_count = count;
+}
@@ -0,0 +1,75 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EEPROM_24LC32A_H
+#define _EEPROM_24LC32A_H
+
+// Model of the Microchip 24LC32A serial EEPROM on the native Wire bus:
+// - 12 bit address, the upper 4 bits of the address high byte are ignored
+// - page writes wrap around inside the 32 byte page
+// - the write cycle starts at the stop condition, the chip does not acknowledge
+//   its address until the cycle is over (ACK polling)
+// - sequential reads run through the whole array and wrap from the last byte to 0
+// Faults for the tests: removed from the socket, write cycle that never ends,
+// slow write cycle and bits flipped while a page is stored.
+
+#include <Wire.h>
+
+#define EEP_24LC32A_SIZE        (4096u)
+#define EEP_24LC32A_PAGE_SIZE   (32u)
+#define EEP_24LC32A_WRITE_US    (5000u)     // write cycle time, datasheet maximum
+
+class Eeprom24LC32A : public NativeI2CDevice
+{
+public:
+    Eeprom24LC32A(uint8_t address = 0x50);
+    bool start(bool read) override;
+    bool write(uint8_t data) override;
+    uint8_t read(void) override;
+    void stop(void) override;
+    bool busy(void);
+    void erase(uint8_t value = 0xFF);
+    uint8_t *get_memory(void) {return mem;}
+    uint32_t get_write_cycles(void) {return write_cycles;}
+    uint32_t get_busy_nacks(void) {return busy_nacks;}
+    uint32_t get_bytes_read(void) {return bytes_read;}
+    // faults
+    void set_present(bool present) {this->present = present;}
+    void set_stuck(bool stuck) {this->stuck = stuck;}
+    void set_write_us(uint32_t us) {write_us = us;}
+    void set_bit_flip(uint16_t addr, uint8_t mask, uint32_t count = 1);
+private:
+    uint8_t mem[EEP_24LC32A_SIZE];
+    uint16_t ptr = 0;               // address counter
+    uint8_t addr_bytes = 0;         // address bytes received since the start
+    bool reading = false;
+    uint8_t page_buf[EEP_24LC32A_PAGE_SIZE];
+    uint32_t page_loaded = 0;       // bytes of the page latch written, one bit each
+    uint16_t page_addr = 0;
+    uint64_t busy_until_ns = 0;
+    bool present = true;
+    bool stuck = false;             // write cycle never ends
+    uint32_t write_us = EEP_24LC32A_WRITE_US;
+    uint16_t flip_addr = 0;
+    uint8_t flip_mask = 0;
+    uint32_t flip_count = 0;        // write cycles storing the flipped byte
+    uint32_t write_cycles = 0;
+    uint32_t busy_nacks = 0;
+    uint32_t bytes_read = 0;
+};
+
+#endif // _EEPROM_24LC32A_H
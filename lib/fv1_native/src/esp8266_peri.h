@@ -0,0 +1,51 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_NATIVE_ESP8266_PERI_H
+#define _FV1_NATIVE_ESP8266_PERI_H
+
+// Virtual GPIO register file at the ESP8266 register offsets, so the register level
+// macros of fv1_hal.h (including the computed GPES/GPEC address) run unchanged.
+// Every access costs CPU cycles on the virtual clock and lets the attached pin models
+// (see fv1_native.h) catch up first.
+
+#include <stdint.h>
+
+uint32_t native_gpio_read(uint32_t addr);
+void native_gpio_write(uint32_t addr, uint32_t value);
+
+class NativeGpioReg
+{
+public:
+    explicit NativeGpioReg(uint32_t addr) : addr(addr) {}
+    operator uint32_t() const {return native_gpio_read(addr);}
+    const NativeGpioReg &operator=(uint32_t value) const {native_gpio_write(addr, value); return *this;}
+private:
+    uint32_t addr;
+};
+
+#define ESP8266_REG(addr)   NativeGpioReg(addr)
+
+#define GPO                 ESP8266_REG(0x300)  // output latch
+#define GPOS                ESP8266_REG(0x304)  // output latch set
+#define GPOC                ESP8266_REG(0x308)  // output latch clear
+#define GPE                 ESP8266_REG(0x30C)  // output enable
+#define GPES                ESP8266_REG(0x310)  // output enable set
+#define GPEC                ESP8266_REG(0x314)  // output enable clear
+#define GPI                 ESP8266_REG(0x318)  // input levels
+
+#endif // _FV1_NATIVE_ESP8266_PERI_H
@@ -0,0 +1,242 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fv1_master.h"
+
+// -----------------------------------------------------------------------------------------------------
+Fv1Master::Fv1Master(void)
+{
+    cfg.scl_hz = 100000;
+    cfg.jitter_ns = 0;
+    cfg.seed = 1;
+    cfg.setup_ns = 100;
+    cfg.start_us = 1000;
+    cfg.pulse_min_us = 0;
+    cfg.rst_pin = 14;
+    cfg.eep_addr = 0x50;
+    cfg.prg_addr = 0;
+    memset(data, 0, sizeof(data));
+    memset(levels, 1, sizeof(levels));
+}
+// -----------------------------------------------------------------------------------------------------
+void Fv1Master::set_config(const fv1_master_cfg_t &cfg)
+{
+    this->cfg = cfg;
+    rand_state = cfg.seed ? cfg.seed : 1;
+    result = {};
+}
+// -----------------------------------------------------------------------------------------------------
+void Fv1Master::run(uint64_t now_ns)
+{
+    while (phase != PH_IDLE && next_ns <= now_ns)
+        step(next_ns);
+}
+// -----------------------------------------------------------------------------------------------------
+void Fv1Master::changed(uint64_t now_ns)
+{
+    bool rst = !(native_gpio_levels() & (1u << cfg.rst_pin));
+    if (rst && !rst_low)
+    {
+        rst_low_ns = now_ns;
+        if (phase != PH_IDLE)
+        {
+            // a new notify pulse restarts the read
+            phase = PH_IDLE;
+            scl_low = false;
+            sda_low = false;
+        }
+    }
+    else if (!rst && rst_low && now_ns - rst_low_ns >= cfg.pulse_min_us * 1000ull)
+    {
+        phase = PH_START;
+        next_ns = now_ns + cfg.start_us * 1000ull;
+    }
+    rst_low = rst;
+
+    bool sda = slave_sda();
+    if (sda != sda_level)
+    {
+        if (phase != PH_IDLE && phase != PH_START && !scl_low)
+            result.glitches++;
+        sda_prev = sda_level;
+        sda_level = sda;
+        sda_change_ns = now_ns;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+uint32_t Fv1Master::get_pull_low(void)
+{
+    return (scl_low ? 1u << SCL : 0) | (sda_low ? 1u << SDA : 0);
+}
+// -----------------------------------------------------------------------------------------------------
+void Fv1Master::step(uint64_t t)
+{
+    switch (phase)
+    {
+    case PH_START:
+        result.transfers++;
+        result.done = false;
+        result.acked = true;
+        result.nack_slot = 0;
+        result.start_ns = t;
+        memset(levels, 1, sizeof(levels));
+        slot = 0;
+        sda_low = true;
+        phase = PH_FALL;
+        next_ns = t + half_period();
+        break;
+    case PH_FALL:
+        scl_low = true;
+        edge_ns = t + half_period();
+        phase = PH_SDA;
+        next_ns = t + (edge_ns - t) / 2;
+        break;
+    case PH_SDA:
+        sda_low = master_sda_low();
+        phase = PH_RISE;
+        next_ns = edge_ns;
+        break;
+    case PH_RISE:
+        scl_low = false;
+        sample(t);
+        edge_ns = t + half_period();
+        if (slot == FV1M_HDR_RESTART || slot == FV1M_STOP_SLOT)
+        {
+            phase = PH_HIGH;
+            next_ns = t + (edge_ns - t) / 2;
+        }
+        else
+        {
+            // a missing ACK ends the read with a STOP
+            slot = result.acked ? slot + 1 : FV1M_STOP_SLOT;
+            phase = PH_FALL;
+            next_ns = edge_ns;
+        }
+        break;
+    case PH_HIGH:
+        if (slot == FV1M_STOP_SLOT)
+        {
+            sda_low = false;
+            result.done = result.acked;
+            result.end_ns = t;
+            phase = PH_IDLE;
+            break;
+        }
+        sda_low = true;     // repeated START
+        slot++;
+        phase = PH_FALL;
+        next_ns = edge_ns;
+        break;
+    default:
+        break;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void Fv1Master::sample(uint64_t t)
+{
+    // level the slave had setup_ns before the edge
+    bool sda = sda_level;
+    if (sda_change_ns + cfg.setup_ns > t)
+    {
+        sda = sda_prev;
+        result.late_bits++;
+    }
+    switch (slot)
+    {
+    case FV1M_HDR_ACK_ADDR_W:
+    case FV1M_HDR_ACK_PTR_H:
+    case FV1M_HDR_ACK_PTR_L:
+    case FV1M_HDR_ACK_ADDR_R:
+        if (sda)
+        {
+            result.acked = false;
+            result.nack_slot = slot;
+        }
+        return;
+    default:
+        break;
+    }
+    if (slot < FV1M_DATA_SLOT || slot >= FV1M_STOP_SLOT)
+        return;
+    uint16_t clk = slot - FV1M_DATA_SLOT;
+    uint16_t pos = clk / 9;
+    levels[clk] = sda;
+    if (clk % 9 != 8)
+        data[pos] = (data[pos] << 1) | sda;
+}
+// -----------------------------------------------------------------------------------------------------
+bool Fv1Master::master_sda_low(void)
+{
+    uint8_t byte;
+    uint8_t bit;
+
+    if (slot < FV1M_HDR_ACK_ADDR_W)
+    {
+        byte = cfg.eep_addr << 1;
+        bit = slot;
+    }
+    else if (slot > FV1M_HDR_ACK_ADDR_W && slot < FV1M_HDR_ACK_PTR_H)
+    {
+        byte = cfg.prg_addr >> 8;
+        bit = slot - FV1M_HDR_ACK_ADDR_W - 1;
+    }
+    else if (slot > FV1M_HDR_ACK_PTR_H && slot < FV1M_HDR_ACK_PTR_L)
+    {
+        byte = cfg.prg_addr & 0xFF;
+        bit = slot - FV1M_HDR_ACK_PTR_H - 1;
+    }
+    else if (slot > FV1M_HDR_RESTART && slot < FV1M_HDR_ACK_ADDR_R)
+    {
+        byte = (cfg.eep_addr << 1) | 1;
+        bit = slot - FV1M_HDR_RESTART - 1;
+    }
+    else if (slot >= FV1M_DATA_SLOT && slot < FV1M_STOP_SLOT)
+    {
+        // ACK after each byte but the last one
+        uint16_t clk = slot - FV1M_DATA_SLOT;
+        return clk % 9 == 8 && clk != FV1M_DATA_CLOCKS - 1;
+    }
+    else
+    {
+        // ACK clocks and the repeated START released, STOP starts low
+        return slot == FV1M_STOP_SLOT;
+    }
+    return !(byte & (0x80 >> bit));
+}
+// -----------------------------------------------------------------------------------------------------
+bool Fv1Master::slave_sda(void)
+{
+    // bus level without the own pull
+    bool own = sda_low;
+    sda_low = false;
+    bool sda = native_gpio_levels() & (1u << SDA);
+    sda_low = own;
+    return sda;
+}
+// -----------------------------------------------------------------------------------------------------
+uint32_t Fv1Master::half_period(void)
+{
+    int64_t ns = 500000000u / cfg.scl_hz;
+    if (cfg.jitter_ns)
+    {
+        // xorshift32
+        rand_state ^= rand_state << 13;
+        rand_state ^= rand_state >> 17;
+        rand_state ^= rand_state << 5;
+        ns += (int64_t)(rand_state % (2 * cfg.jitter_ns + 1)) - cfg.jitter_ns;
+    }
+    return ns > 1 ? ns : 1;
+}
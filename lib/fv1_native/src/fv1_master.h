@@ -0,0 +1,106 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_MASTER_H
+#define _FV1_MASTER_H
+
+// Model of the FV-1 reading a program from its EEPROM, driving SCL/SDA through the
+// virtual GPIO register file against the bit-banged slave of trig_read:
+// - starts after a notify pulse on the reset pin
+// - START, address write, pointer high/low, repeated START, address read: the slave
+//   has to ACK at the clocks 8/17/26/36 counted from the first falling SCL edge
+// - then 512 bytes read, ACK by the master after each byte, NACK after the last, STOP
+// SDA is sampled at the rising SCL edge and has to be stable for setup_ns before it.
+// Every SCL half period varies by up to +-jitter_ns (pseudo random, seeded).
+
+#include "fv1_native.h"
+
+#define FV1M_PRG_SIZE           (512u)
+#define FV1M_HDR_ACK_ADDR_W     8
+#define FV1M_HDR_ACK_PTR_H      17
+#define FV1M_HDR_ACK_PTR_L      26
+#define FV1M_HDR_RESTART        27          // SDA released, repeated START while SCL is high
+#define FV1M_HDR_ACK_ADDR_R     36
+#define FV1M_DATA_SLOT          (FV1M_HDR_ACK_ADDR_R + 1)
+#define FV1M_DATA_CLOCKS        (FV1M_PRG_SIZE * 9u)
+#define FV1M_STOP_SLOT          (FV1M_DATA_SLOT + FV1M_DATA_CLOCKS)
+
+typedef struct
+{
+    uint32_t scl_hz;            // SCL clock rate
+    uint32_t jitter_ns;         // max deviation of each SCL half period
+    uint32_t seed;              // jitter sequence
+    uint32_t setup_ns;          // SDA setup time before the rising SCL edge
+    uint32_t start_us;          // reset release to the START condition
+    uint32_t pulse_min_us;      // shorter notify pulses are ignored
+    uint8_t rst_pin;
+    uint8_t eep_addr;           // sent in the header, the slave does not check it
+    uint16_t prg_addr;
+}fv1_master_cfg_t;
+
+typedef struct
+{
+    uint32_t transfers;         // reads started
+    bool done;                  // last read ended with a STOP
+    bool acked;                 // all header ACKs of the last read seen
+    uint8_t nack_slot;          // clock of the missing ACK
+    uint32_t late_bits;         // samples taken while SDA changed within the setup time
+    uint32_t glitches;          // slave changed SDA while SCL was high
+    uint64_t start_ns;
+    uint64_t end_ns;
+}fv1_master_result_t;
+
+class Fv1Master : public NativeGpioDevice
+{
+public:
+    Fv1Master(void);
+    void set_config(const fv1_master_cfg_t &cfg);
+    const fv1_master_cfg_t &get_config(void) {return cfg;}
+    const fv1_master_result_t &get_result(void) {return result;}
+    const uint8_t *get_data(void) {return data;}                // bytes of the last read
+    const uint8_t *get_levels(void) {return levels;}            // slave SDA level per data clock
+    bool busy(void) {return phase != PH_IDLE;}
+    void run(uint64_t now_ns) override;
+    void changed(uint64_t now_ns) override;
+    uint32_t get_pull_low(void) override;
+private:
+    typedef enum {PH_IDLE, PH_START, PH_FALL, PH_SDA, PH_RISE, PH_HIGH} phase_t;
+    void step(uint64_t t);
+    void sample(uint64_t t);
+    bool master_sda_low(void);
+    bool slave_sda(void);
+    uint32_t half_period(void);
+
+    fv1_master_cfg_t cfg;
+    fv1_master_result_t result = {};
+    phase_t phase = PH_IDLE;
+    uint64_t next_ns = 0;           // time of the next bus event
+    uint64_t edge_ns = 0;           // end of the current SCL half period
+    uint16_t slot = 0;              // SCL clock, counted from the first falling edge
+    bool scl_low = false;
+    bool sda_low = false;
+    bool rst_low = false;
+    uint64_t rst_low_ns = 0;
+    bool sda_level = true;          // slave SDA level, changed at sda_change_ns
+    bool sda_prev = true;
+    uint64_t sda_change_ns = 0;
+    uint32_t rand_state = 1;
+    uint8_t data[FV1M_PRG_SIZE];
+    uint8_t levels[FV1M_DATA_CLOCKS];
+};
+
+#endif // _FV1_MASTER_H
@@ -0,0 +1,73 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_NATIVE_H
+#define _FV1_NATIVE_H
+
+// Controls of the native (Linux) build used by the tests and benchmarks.
+//
+// Time is virtual and only moves when the firmware waits or touches the hardware:
+// delay(), I2C transfers (bit time at the set clock) and every GPIO register or
+// cycle counter access (CPU cycles below). Results do not depend on the host load.
+// The access costs are estimates, calibrate them with the poll loop iterations and
+// cycles shown on /stats of a real unit (last_cycles / data_iters per poll).
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#ifndef FV1_DATA_DIR
+#define FV1_DATA_DIR        "data"      // hex files used by the tests
+#endif
+
+typedef struct
+{
+    uint32_t cpu_mhz;               // ESP.getCpuFreqMHz(), rate of the cycle counter
+    uint32_t free_heap;             // ESP.getFreeHeap()
+    uint32_t gpio_read_cycles;      // GPI read, including the poll loop around it
+    uint32_t gpio_write_cycles;     // GPO/GPE set or clear
+    uint32_t cycle_count_cycles;    // ESP.getCycleCount()
+    uint32_t wdt_feed_cycles;       // ESP.wdtFeed()
+}native_cpu_t;
+
+extern native_cpu_t native_cpu;
+
+// virtual clock
+uint64_t native_time_ns(void);
+void native_advance_ns(uint64_t ns);
+void native_advance_cycles(uint32_t cycles);
+
+// Pin model attached to the GPIO register file, e.g. an I2C master driving SCL.
+// run() is called before every register access with the current time, a model
+// processes its own events up to then and still sees the pin levels before the access.
+// changed() follows every register write, after the new levels are in effect.
+class NativeGpioDevice
+{
+public:
+    virtual ~NativeGpioDevice() {}
+    virtual void run(uint64_t now_ns) {(void)now_ns;}
+    virtual void changed(uint64_t now_ns) {(void)now_ns;}
+    virtual uint32_t get_pull_low(void) {return 0;}    // pins held low by the model
+};
+
+void native_gpio_attach(NativeGpioDevice *dev);
+void native_gpio_detach(NativeGpioDevice *dev);
+uint32_t native_gpio_levels(void);  // wired-AND of the outputs, pull-ups and models, no cost
+
+// copies a file of the host into the in-memory file system
+bool native_fs_load(FS &fs, const char *host_path, const String &path);
+
+#endif // _FV1_NATIVE_H
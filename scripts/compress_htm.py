@@ -0,0 +1,64 @@
+"""
+FV1 DevRemote web interface compression
+PlatformIO extra script, run before the file system image is built.
+
+Every file in data/htm gets a gzipped copy next to it (index.html -> index.html.gz),
+the web server sends the .gz file to browsers accepting gzip and the original
+one to the rest. The compressed pages link the assets with their fingerprint,
+/htm/style.css?v=<CRC32 of style.css.gz>, the ETag the server sends for it. A
+fingerprinted asset is cached for a year, everything else is revalidated.
+A copy is only rebuilt if its sources are newer, fixed gzip header time keeps
+the images reproducible.
+"""
+
+import gzip
+import os
+import zlib
+from SCons.Script import COMMAND_LINE_TARGETS
+
+Import("env")
+
+FS_TARGETS = ("buildfs", "uploadfs", "uploadfsota")
+HTM_DIR = os.path.join(env.subst("$PROJECT_DATA_DIR"), "htm")
+
+
+def write_gz(dst, data):
+    with open(dst, "wb") as f_out:
+        with gzip.GzipFile(filename="", mode="wb", compresslevel=9, fileobj=f_out, mtime=0) as gz:
+            gz.write(data)
+    print("compress_htm: %s %d -> %d bytes" % (os.path.basename(dst), len(data), os.path.getsize(dst)))
+
+
+def is_newer(dst, sources):
+    return not os.path.exists(dst) or any(os.path.getmtime(s) > os.path.getmtime(dst) for s in sources)
+
+
+def compress_htm():
+    names = [n for n in sorted(os.listdir(HTM_DIR))
+             if not n.endswith(".gz") and os.path.isfile(os.path.join(HTM_DIR, n))]
+    assets = [n for n in names if not n.endswith(".html")]
+    pages = [n for n in names if n.endswith(".html")]
+    fingerprint = {}
+    for name in assets:
+        src = os.path.join(HTM_DIR, name)
+        dst = src + ".gz"
+        if is_newer(dst, [src]):
+            with open(src, "rb") as f_in:
+                write_gz(dst, f_in.read())
+        with open(dst, "rb") as f_in:
+            fingerprint[name] = "%08x" % (zlib.crc32(f_in.read()) & 0xFFFFFFFF)
+    for name in pages:
+        src = os.path.join(HTM_DIR, name)
+        dst = src + ".gz"
+        if not is_newer(dst, [src] + [os.path.join(HTM_DIR, a + ".gz") for a in assets]):
+            continue
+        with open(src, "rb") as f_in:
+            data = f_in.read()
+        for asset, crc in fingerprint.items():
+            link = ('"/htm/%s' % asset).encode()
+            data = data.replace(link + b'"', link + ('?v=%s"' % crc).encode())
+        write_gz(dst, data)
+
+
+if any(t in FS_TARGETS for t in COMMAND_LINE_TARGETS):
+    compress_htm()
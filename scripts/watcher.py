@@ -34,6 +34,8 @@ import os
 import sys
 import re
 import argparse
+import json
+from io import BytesIO
 
 
 def get_valid_filename(s):
@@ -47,52 +49,56 @@ def get_valid_filename(s):
     return re.sub(r'(?u)[^\w.]', '', s)
 
 
-def enable_file(file_name, fv1_url):
-    url_addr = fv1_url + '/enable?file=/' + file_name
-    c = pycurl.Curl()
-    c.setopt(c.URL, url_addr)
-    print(f'enabling file {file_name}')
-    c.perform()
-    url_addr = fv1_url + '/trigrefresh'
-    c.setopt(c.URL, url_addr)
-    c.perform()
-    c.close()
-
-
-def upload_file(file_path, fv1_url, verb):
+def load_file(file_path, fv1_url, verb, prg=None):
     """
-    Upload file using curl
-    :param verb: verbose
+    Upload, enable and optionally select a program in a single request
     :param file_path:
     :param fv1_url:
-    :return: abs file url path of uploaded file.
+    :param verb: verbose
+    :param prg: program 0-7 to select, None keeps the current one
+    :return: device reply (json)
     """
     if file_path is None or not os.path.exists(file_path):
         print("File '{}' cant be uploaded".format(file_path))
         return
     valid_fname = get_valid_filename(Path(file_path).name)
-    upload_url = fv1_url + '/uploadhex?f='
+    load_url = fv1_url + '/devload?file=/' + valid_fname
+    if prg is not None:
+        load_url += '&prg=' + str(prg)
+    with open(file_path, 'rb') as f:
+        data = f.read()
+    reply = BytesIO()
     c = pycurl.Curl()
     c.setopt(c.VERBOSE, int(verb))
-    c.setopt(c.POST, 1)
-    c.setopt(c.URL, upload_url)
-    c.setopt(c.HTTPPOST, [("file1", (c.FORM_FILE, file_path, c.FORM_FILENAME, valid_fname))])
-    print(f"Uploading file {file_path} as {valid_fname} to url {upload_url}")
+    c.setopt(c.URL, load_url)
+    c.setopt(c.POSTFIELDS, data)
+    c.setopt(c.HTTPHEADER, ['Content-Type: application/octet-stream'])
+    c.setopt(c.WRITEDATA, reply)
+    print(f"Loading file {file_path} as {valid_fname} to url {load_url}")
     c.perform()
     c.close()
-    return valid_fname
+    try:
+        status = json.loads(reply.getvalue())
+    except ValueError:
+        print(reply.getvalue().decode(errors='replace'))
+        return
+    t = status['timeUs']
+    print(f"{status['result']} - receive {t['receive'] / 1000:.1f} ms, store {t['store'] / 1000:.1f} ms, "
+          f"enable {t['enable'] / 1000:.1f} ms, select {t['select'] / 1000:.1f} ms, total {t['total'] / 1000:.1f} ms")
+    return status
 
 
 class Watcher:
 
-    def __init__(self, pathToWatch, url, verb):
+    def __init__(self, pathToWatch, url, verb, prg):
         self.observer = Observer()
         self.dir_to_watch = pathToWatch
         self.board_url = url
         self.ver_out = verb
+        self.prg = prg
 
     def run(self):
-        event_handler = Handler(self.board_url, self.ver_out)
+        event_handler = Handler(self.board_url, self.ver_out, self.prg)
         self.observer.schedule(event_handler, self.dir_to_watch, recursive=True)
         self.observer.start()
         try:
@@ -109,9 +115,10 @@ class Handler(FileSystemEventHandler):
     board_url = []
     last_time = 0
 
-    def __init__(self, url, verb):
+    def __init__(self, url, verb, prg):
         self.board_url = url
         self.verb_out = verb
+        self.prg = prg
 
     def on_modified(self, event):
         if event.is_directory:
@@ -120,16 +127,15 @@ class Handler(FileSystemEventHandler):
             # Taken any action here when a file is modified.
             # checks for the last modification time to avoid double triggers due to system operations
             # file extension is hex
-            # length is 21517 (windows) or 20492 (unix/macos)
+            # any length is accepted, partial banks hold only some of the programs
             file_stats = os.stat(event.src_path)
             new_time = int(file_stats.st_ctime)
             file_len = file_stats.st_size
             file_suffix = Path(event.src_path).suffix
-            if new_time > self.last_time and file_suffix.upper() == '.HEX' and (file_len == 21517 or file_len == 20492):
+            if new_time > self.last_time and file_suffix.upper() == '.HEX' and file_len > 0:
                 print('-'*32)
                 print(f"File modified - {event.src_path}")
-                valid_name = upload_file(event.src_path, self.board_url, self.verb_out)
-                enable_file(valid_name, self.board_url)
+                load_file(event.src_path, self.board_url, self.verb_out, self.prg)
                 print('-' * 32)
                 self.last_time = new_time
 
@@ -141,10 +147,12 @@ def __main(argv):
     parser.add_argument('-u', '--url', type=str, default='http://fv1.local', help="FV1 DevRemote base url")
     parser.add_argument('-d', '--dir', type=str, default=os.getcwd(), help="Directory to watch")
     parser.add_argument('-v', '--verbose', action='store_true', default=False, help="Verbose mode")
+    parser.add_argument('-p', '--prg', type=int, choices=range(8), default=None,
+                        help="Program 0-7 to select after each upload")
     args = parser.parse_args()
     print(f"URL of the board: {args.url}")
     print(f"Starting watcher in directory {args.dir}")
-    w = Watcher(args.dir, args.url, args.verbose)
+    w = Watcher(args.dir, args.url, args.verbose, args.prg)
     w.run()
 
 
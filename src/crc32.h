@@ -0,0 +1,36 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CRC32_H
+#define _CRC32_H
+
+// Standard CRC-32 (IEEE 802.3, same as zlib/PKZIP), nibble table driven.
+// crc32_update() can be called repeatedly on consecutive chunks:
+//      crc = crc32_update(CRC32_INIT, chunk1, len1);
+//      crc = crc32_update(crc, chunk2, len2);
+//      result = crc32_final(crc);
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC32_INIT  (0xFFFFFFFFu)
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+static inline uint32_t crc32_final(uint32_t crc) {return crc ^ 0xFFFFFFFFu;}
+static inline uint32_t crc32_calc(const uint8_t *data, size_t len) {return crc32_final(crc32_update(CRC32_INIT, data, len));}
+
+#endif // _CRC32_H
@@ -15,15 +15,49 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "fv1.h"
-#include "Wire.h"
+#include "fv1_hal.h"
 #include "SparkFun_External_EEPROM.h"
+#include "ihex.h"
+#include "crc32.h"
 
-#define FV1_HEXFILE_SIZE_WIN            (21517u) // length of the SpinASM output hex file
-#define FV1_HEXFILE_SIZE_UNIX           (20492u)   
-#define IHEX_START ':'
-#define I2C_SLAVE_TIMEOUT_TICKS 0x8000
+#define FV1_LOAD_CHUNK_SIZE            (256u)   // hex file read chunk, stack buffer
+// FV-1 program read as seen by the slave, counted in SCL falling edges:
+// address+W, pointer H, pointer L, (repeated start) address+R, each followed by an ACK,
+// then 512 data bytes, each followed by the master's ACK
+#define I2C_HDR_ACK_ADDR_W      8
+#define I2C_HDR_ACK_PTR_H       17
+#define I2C_HDR_ACK_PTR_L       26
+#define I2C_HDR_ACK_ADDR_R      36      // one extra clock for the repeated start
+#define I2C_HDR_CLOCKS          (I2C_HDR_ACK_ADDR_R + 1)
+#define I2C_BYTE_CLOCKS         (9u)    // 8 data bits + ACK
+#define I2C_DATA_CLOCKS         (FV1_PRG_SIZE * I2C_BYTE_CLOCKS)
+#define SDA_STREAM_WORDS        (I2C_DATA_CLOCKS / 32)
 
-bool IRAM_ATTR trig_read(uint8_t *dataPtr, uint8_t rst);
+// SDA level for every data phase clock, MSB first, prepared by set_prg
+static uint32_t sda_stream[SDA_STREAM_WORDS + 1];    // +1: reload after the last clock
+static void sda_stream_encode(const uint8_t *dataPtr, uint32_t *stream);
+
+// one i2c read request as long as the rx buffer allows
+#define FV1_EEP_READ_BURST      ((I2C_BUFFER_LENGTH_RX < FV1_PRG_SIZE) ? I2C_BUFFER_LENGTH_RX : FV1_PRG_SIZE)
+
+static fv1_edge_stats_t edge_stats;
+#ifdef FV1_EDGE_STATS
+// cycle count of the last poll that saw SCL high, the edge happened after that
+#define EDGE_STATS_POLL(clk, now)   if (clk) edge_t = now
+#define EDGE_STATS_EDGE()       edge_stats_add(hal_cycles() - edge_t)
+static inline void IRAM_ATTR edge_stats_add(uint32_t cycles)
+{
+    uint32_t bucket = cycles >> FV1_EDGE_STATS_SHIFT;
+    edge_stats.edge_hist[bucket < FV1_EDGE_STATS_BUCKETS ? bucket : FV1_EDGE_STATS_BUCKETS - 1]++;
+    if (cycles > edge_stats.edge_max)
+        edge_stats.edge_max = cycles;
+}
+#else
+#define EDGE_STATS_POLL(clk, now)
+#define EDGE_STATS_EDGE()
+#endif
+
+bool IRAM_ATTR trig_read(const uint32_t *stream, uint8_t rst, uint32_t pulse_cycles, uint32_t start_cycles, uint32_t idle_cycles);
 
 ExternalEEPROM eep;
 
@@ -38,20 +72,14 @@ FV1::FV1(uint8_t dspP, uint8_t eepselP)
 String FV1::begin(void)
 {
     eep.setMemorySize(32768 / 8); // 24LC32A
-    eep.setPageSize(32);          //In bytes.
+    eep.setPageSize(FV1_EEP_PAGE_SIZE); //In bytes.
+    // no unbounded ACK polling in the library, a stuck chip would hang loop(); chunk writes
+    // wait the page write time instead, the burn polls with a time limit (waitForWriteComplete)
+    eep.disablePollForWriteComplete();
 
-    GPOC = (1 << SDA); // set SDA low
-    pinMode(SCL, INPUT_PULLUP);
-    pinMode(SDA, INPUT_PULLUP);
-    pinMode(dsprst_pin, OUTPUT_OPEN_DRAIN);
-    digitalWrite(dsprst_pin, HIGH);
-    pinMode(eep_select_pin, OUTPUT);
-    digitalWrite(eep_select_pin, HIGH);
-    GPOC = (1 << SDA); // set output SDA low
-    GPEC = (1 << SDA); // SDA output OFF (= Open Drain Hi)
-    GPEC = (1 << SCL); // SDA High
+    slave_init();
     // load last used file
-    File last_used = LittleFS.open("/htm/last.ini", "r");
+    File last_used = FV1_FS.open("/htm/last.ini", "r");
     String data = last_used.readString();
     last_used.close();
     Serial.print("last used file = ");
@@ -62,182 +90,661 @@ String FV1::begin(void)
     return data;
 }
 // -----------------------------------------------------------------------------------------------------
+void FV1::slave_init(void)
+{
+    HAL_SDA_LATCH_LOW(); // set SDA low
+    hal_pin_mode(SCL, INPUT_PULLUP);
+    hal_pin_mode(SDA, INPUT_PULLUP);
+    hal_pin_mode(dsprst_pin, OUTPUT_OPEN_DRAIN);
+    hal_pin_write(dsprst_pin, HIGH);
+    hal_pin_mode(eep_select_pin, OUTPUT);
+    hal_pin_write(eep_select_pin, HIGH);
+    HAL_SDA_LATCH_LOW(); // set output SDA low
+    HAL_SDA_RELEASE(); // SDA output OFF (= Open Drain Hi)
+    HAL_SCL_RELEASE(); // SDA High
+}
+// -----------------------------------------------------------------------------------------------------
 bool FV1::set_prg(uint8_t prg_no)
 {
-    if (prg_no > 7 || !dsp_fw_ptr)
+    if (prg_no >= FV1_PRG_COUNT || !dsp_fw_ptr)
         return false;
     bool result = false;
     current_program = prg_no;
-    dsp_fw_ptr = &dsp_fw_bf[512 * current_program];
+    dsp_fw_ptr = &dsp_fw_bf[FV1_PRG_SIZE * current_program];
     Serial.print("Setting program: ");
     Serial.println(prg_no);
-    result = trig_read(dsp_fw_ptr, dsprst_pin);
+    result = transfer(dsp_fw_ptr);
     if (!result) {Serial.print(F("Error loading program ")); Serial.println(prg_no);}
     return result;
 }
 // -----------------------------------------------------------------------------------------------------
+bool FV1::set_prg(const String &path, uint8_t prg_no)
+{
+    if (prg_no >= FV1_PRG_COUNT || !FV1_FS.exists(path))
+        return false;
+    File hexfile = FV1_FS.open(path, "r");
+    uint32_t src_size = hexfile.size();
+    uint32_t src_mtime = hexfile.getLastWrite();
+    uint8_t prg_mask = 0;
+    // cached bank, or a single program read from the image next to the hex file
+    const uint8_t *cached = ram_cache.get(path, src_size, src_mtime, prg_mask);
+    bool found = false;
+    if (cached)
+    {
+        if (prg_mask & (1 << prg_no))
+        {
+            memcpy(prg_bf, &cached[FV1_PRG_SIZE * prg_no], FV1_PRG_SIZE);
+            found = true;
+        }
+    }
+    else if (!(found = load_image_prg(path, hexfile, prg_no, prg_bf)))
+    {
+        // no valid image yet, decode the whole file once and store it for the next time
+        uint8_t *image = (uint8_t *)malloc(FV1_IMAGE_SIZE);
+        if (image)
+        {
+            memset(image, 0, FV1_IMAGE_SIZE);
+            hexfile.seek(0);
+            if (decode_file(hexfile, image, prg_mask) == FV1_OK)
+            {
+                save_image(path, image, prg_mask);
+                ram_cache.put(path, src_size, src_mtime, image, prg_mask);
+                if (prg_mask & (1 << prg_no))
+                {
+                    memcpy(prg_bf, &image[FV1_PRG_SIZE * prg_no], FV1_PRG_SIZE);
+                    found = true;
+                }
+            }
+            free(image);
+        }
+    }
+    hexfile.close();
+    if (!found)
+        return false;
+    Serial.print("Setting program: ");
+    Serial.print(path);
+    Serial.print(" / ");
+    Serial.println(prg_no);
+    bool result = transfer(prg_bf);
+    if (!result) {Serial.print(F("Error loading program ")); Serial.println(prg_no);}
+    return result;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::transfer(const uint8_t *prg)
+{
+    uint32_t mhz = hal_cpu_mhz();
+    uint32_t pulse_us = timing.rst_pulse_us;
+    bool result;
+
+    sda_stream_encode(prg, sda_stream);
+    // no answer from the FV-1 usually means the notify pulse was too short, retry with a longer one
+    while (!(result = trig_read(sda_stream, dsprst_pin, pulse_us * mhz, timing.start_us * mhz, timing.idle_us * mhz)) &&
+           pulse_us < timing.rst_pulse_max_us)
+    {
+        pulse_us = min(pulse_us * 2, timing.rst_pulse_max_us);
+        timing.retries++;
+    }
+    if (result)
+        timing.rst_pulse_us = pulse_us;
+    return result;
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::set_timing(uint32_t pulse_min_us, uint32_t pulse_max_us, uint32_t start_us, uint32_t idle_us)
+{
+    timing.rst_pulse_min_us = pulse_min_us ? pulse_min_us : 1;
+    timing.rst_pulse_max_us = max(pulse_max_us, timing.rst_pulse_min_us);
+    timing.rst_pulse_us = timing.rst_pulse_min_us;     // search the shortest pulse again
+    timing.start_us = start_us;
+    timing.idle_us = idle_us;
+}
+// -----------------------------------------------------------------------------------------------------
+uint32_t FV1::request_prg(uint8_t prg_no)
+{
+    return request_prg(String(), prg_no);
+}
+// -----------------------------------------------------------------------------------------------------
+uint32_t FV1::request_prg(const String &path, uint8_t prg_no)
+{
+    if (prg_req.pending)
+        prg_req.coalesced++;
+    prg_req.req_path = path;
+    prg_req.req_prg = prg_no;
+    prg_req.pending = true;
+    return ++prg_req.req_seq;
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::process(void)
+{
+    if (burn_busy())
+    {
+        burn_process();     // the slave i2c lines are used by the EEPROM burn, switch later
+        if (prod_stats.state != FV1_PROD_OFF)
+            prod_led(hal_millis());
+        return;
+    }
+    if (prod_stats.state != FV1_PROD_OFF)
+    {
+        prod_process();     // i2c master for the whole production run, no program switches
+        return;
+    }
+    if (!prg_req.pending)
+        return;
+    // only the latest request is executed, clicks received meanwhile were merged into it
+    uint32_t seq = prg_req.req_seq;
+    uint8_t prg_no = prg_req.req_prg;
+    prg_req.pending = false;
+    bool result = prg_req.req_path.length() ? set_prg(prg_req.req_path, prg_no) : set_prg(prg_no);
+    prg_req.done_path = prg_req.req_path;
+    prg_req.done_prg = prg_no;
+    prg_req.done_ok = result;
+    prg_req.done_seq = seq;
+}
+// -----------------------------------------------------------------------------------------------------
+const fv1_edge_stats_t &FV1::get_edge_stats(void)
+{
+    return edge_stats;
+}
+// -----------------------------------------------------------------------------------------------------
 bool FV1::toggle_slave_i2c()
 {
     slave_i2c_state ^= 1;
     if (slave_i2c_state)
     {
-        digitalWrite(eep_select_pin, HIGH);
+        hal_pin_write(eep_select_pin, HIGH);
     }
     else
     {
-        digitalWrite(eep_select_pin, LOW);
-        digitalWrite(dsprst_pin, LOW);
-        delay(100);
-        digitalWrite(dsprst_pin, HIGH);
+        hal_pin_write(eep_select_pin, LOW);
+        hal_pin_write(dsprst_pin, LOW);
+        hal_delay(100);
+        hal_pin_write(dsprst_pin, HIGH);
     }
     return !slave_i2c_state;
 }
 // -----------------------------------------------------------------------------------------------------
 FV1_result_t FV1::load_file(const String &path)
 {
-    uint8_t buffer[24];
-    uint16_t sum = 0, chksum = 0;
-    uint8_t byte_count = 0;
-    uint16_t data_addr = 0x0000;
-    uint8_t type = 0xFF;
-    bool eof_reached = false;
-    dsp_fw_ptr = NULL;
+    FV1_result_t result;
+    uint8_t prg_mask = 0;
 
-    if (!LittleFS.exists(path))
+    if (burn_busy())
+        return FV1_OTHER_ERR;   // the working image is being written to the EEPROM
+    if (!FV1_FS.exists(path))
     {
         return FV1_INPUT_FILE_NOT_FOUND;
     }
 
-    File hexfile = LittleFS.open(path, "r"); // read mode
-
-    if (hexfile.size() == FV1_HEXFILE_SIZE_WIN || hexfile.size() == FV1_HEXFILE_SIZE_UNIX)
+    // Files of any size are accepted, a file may also hold only some of the programs.
+    // Programs present in the file replace the ones in the working image, the others are kept.
+    File hexfile = FV1_FS.open(path, "r"); // read mode
+    uint32_t src_size = hexfile.size();
+    uint32_t src_mtime = hexfile.getLastWrite();
+    // recently used banks are kept in RAM, then try the image cached next to the hex file
+    const uint8_t *cached = ram_cache.get(path, src_size, src_mtime, prg_mask);
+    uint8_t *image = NULL;
+    if (cached)
     {
-        // file legth ok
+        result = FV1_OK;
     }
-    else
+    else if (!(image = (uint8_t *)malloc(FV1_IMAGE_SIZE)))
     {
-        hexfile.close();
-        boot_complete = 1;
-        return FV1_INPUT_FILE_WRONG;
+        result = FV1_OTHER_ERR;
     }
-    // Now let's handle the OS dependant line endings
-    // line end:    Windows:        CRLF \r\n
-    //              Linux           LF     \n
-    //              Mac (preOSX)    CR   \r  
-    hexfile.setTimeout(10);
-    char term = '\r';
-    bool t_found = hexfile.findUntil("\r", &term);
-    if (t_found)
-    {
-        hexfile.seek(0);
-        term = '\n';
-        t_found = hexfile.findUntil("\n", &term);
-        if (t_found)
+    else
+    {
+        // decoded aside, a broken file must not leave a half overwritten working image
+        memset(image, 0, FV1_IMAGE_SIZE);
+        if (load_image(path, hexfile, image, prg_mask))
         {
-           Serial.println(PSTR("Win type file ending detected"));
+            image_hits++;
+            result = FV1_OK;
         }
         else
         {
-            term = '\r';
-            Serial.println(PSTR("Mac (old) type line ending detected"));
-        }  
+            image_misses++;
+            hexfile.seek(0);
+            result = decode_file(hexfile, image, prg_mask);
+            if (result == FV1_OK)
+                save_image(path, image, prg_mask);
+        }
+        if (result == FV1_OK)
+            ram_cache.put(path, src_size, src_mtime, image, prg_mask);
+        cached = image;
     }
-    else
+    hexfile.close();
+    if (result == FV1_OK)
     {
-        hexfile.seek(0);
-        term = '\n';
-        t_found = hexfile.findUntil("\n", &term);
-        if (t_found)
+        for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
         {
-            Serial.println(PSTR("Unix type file ending detected"));
-        }    
+            if (prg_mask & (1 << i))
+                memcpy(&dsp_fw_bf[FV1_PRG_SIZE * i], &cached[FV1_PRG_SIZE * i], FV1_PRG_SIZE);
+        }
     }
-    hexfile.setTimeout(1000);
-    hexfile.seek(0);
-    while (hexfile.available())
+    free(image);
+    if (result != FV1_OK)
+    {
+        boot_complete = 1;
+        return result;  // the previous bank stays enabled
+    }
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        prg_crc[i] = crc32_calc(&dsp_fw_bf[FV1_PRG_SIZE * i], FV1_PRG_SIZE);
+    current_program = 0;
+    dsp_fw_ptr = &dsp_fw_bf[FV1_PRG_SIZE * current_program];
+    if (boot_complete)      // do not save at boot
+    {
+        File last_used = FV1_FS.open("/htm/last.ini", "w");
+        last_used.print(path);
+        last_used.close();       
+    }
+    boot_complete = 1;
+    return FV1_OK;
+}
+// -----------------------------------------------------------------------------------------------------
+FV1_result_t FV1::decode_file(File &hexfile, uint8_t *image, uint8_t &prg_mask)
+{
+    uint8_t chunk[FV1_LOAD_CHUNK_SIZE];
+    IHexDecoder decoder(image, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+    ihex_result_t reply = IHEX_BUSY;
+
+    // decoder handles all OS dependant line endings (CRLF, LF, CR)
+    while (reply == IHEX_BUSY)
+    {
+        size_t len = hexfile.read(chunk, sizeof(chunk));
+        if (!len)
+            break;
+        reply = decoder.feed(chunk, len);
+    }
+    prg_mask = decoder.get_block_mask();
+    return decode_result(decoder.finish(), prg_mask);
+}
+// -----------------------------------------------------------------------------------------------------
+FV1_result_t FV1::decode_result(ihex_result_t reply, uint8_t prg_mask)
+{
+    switch (reply)
+    {
+    case IHEX_DONE:
+        return prg_mask ? FV1_OK : FV1_INPUT_FILE_WRONG; // no program in the file
+    case IHEX_ERR_CHKSUM:
+        return FV1_INPUT_FILE_CHKSUM_ERR;
+    default:
+        return FV1_INPUT_FILE_WRONG;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+String FV1::image_path(const String &path)
+{
+    String ext = path.substring(path.length() - 4);
+    ext.toLowerCase();
+    if (ext == ".hex")
+        return path.substring(0, path.length() - 4) + FV1_IMAGE_EXT;
+    return path + FV1_IMAGE_EXT;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::is_image_path(const String &path)
+{
+    return path.endsWith(FV1_IMAGE_EXT);
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::save_image(const String &path, const uint8_t *image, uint8_t prg_mask)
+{
+    fv1_image_hdr_t hdr;
+    File hexfile = FV1_FS.open(path, "r");
+    if (!hexfile)
+        return false;
+    hdr.magic = FV1_IMAGE_MAGIC;
+    hdr.src_size = hexfile.size();
+    hdr.src_mtime = hexfile.getLastWrite();
+    hdr.prg_mask = prg_mask;
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        hdr.prg_crc[i] = crc32_calc(&image[FV1_PRG_SIZE * i], FV1_PRG_SIZE);
+    hexfile.close();
+
+    File imgfile = FV1_FS.open(image_path(path), "w");
+    if (!imgfile)
+        return false;
+    bool result = imgfile.write((const uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+                  imgfile.write(image, FV1_IMAGE_SIZE) == FV1_IMAGE_SIZE;
+    imgfile.close();
+    if (!result)
+        FV1_FS.remove(image_path(path));
+    return result;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::load_image(const String &path, File &hexfile, uint8_t *image, uint8_t &prg_mask)
+{
+    fv1_image_hdr_t hdr;
+    String img_path = image_path(path);
+
+    if (!FV1_FS.exists(img_path))
+        return false;
+    File imgfile = FV1_FS.open(img_path, "r");
+    bool result = check_image_hdr(imgfile, hexfile, hdr) &&
+                  imgfile.read(image, FV1_IMAGE_SIZE) == FV1_IMAGE_SIZE;
+    // every program is verified, the caller takes them only if all of them are fine
+    for (uint8_t i = 0; i < FV1_PRG_COUNT && result; i++)
+    {
+        if (hdr.prg_mask & (1 << i))
+            result = hdr.prg_crc[i] == crc32_calc(&image[FV1_PRG_SIZE * i], FV1_PRG_SIZE);
+    }
+    imgfile.close();
+    if (!result) // stale or damaged, will be rebuilt after parsing the hex file
+        FV1_FS.remove(img_path);
+    else
+        prg_mask = hdr.prg_mask;
+    return result;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::load_image_prg(const String &path, File &hexfile, uint8_t prg_no, uint8_t *dst)
+{
+    fv1_image_hdr_t hdr;
+    String img_path = image_path(path);
+
+    if (!FV1_FS.exists(img_path))
+        return false;
+    File imgfile = FV1_FS.open(img_path, "r");
+    bool result = check_image_hdr(imgfile, hexfile, hdr) &&
+                  (hdr.prg_mask & (1 << prg_no)) &&
+                  imgfile.seek(sizeof(hdr) + FV1_PRG_SIZE * prg_no) &&
+                  imgfile.read(dst, FV1_PRG_SIZE) == FV1_PRG_SIZE &&
+                  hdr.prg_crc[prg_no] == crc32_calc(dst, FV1_PRG_SIZE);
+    imgfile.close();
+    return result;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::check_image_hdr(File &imgfile, File &hexfile, fv1_image_hdr_t &hdr)
+{
+    return imgfile.size() == sizeof(hdr) + FV1_IMAGE_SIZE &&
+           imgfile.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+           hdr.magic == FV1_IMAGE_MAGIC &&
+           hdr.src_size == hexfile.size() &&
+           hdr.src_mtime == (uint32_t)hexfile.getLastWrite();
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::burn_start(uint8_t slaveAddr, uint32_t i2c_hz, bool page_write, bool force)
+{
+    if (!dsp_fw_ptr || burn_busy())
+        return false;
+    memset(&burn_stats, 0, sizeof(burn_stats));
+    memset(burn_retries, 0, sizeof(burn_retries));
+    burn_addr = slaveAddr;
+    burn_force = force;
+    burn_page = 0;
+    burn_stats.failed_page = -1;
+    burn_stats.state = FV1_BURN_DETECT;
+    // a page plus the 2 address bytes has to fit the I2C buffer to be sent in one transaction
+    burn_stats.page_write = page_write && (eep.getI2CBufferSize() >= FV1_EEP_PAGE_SIZE + 2);
+    burn_stats.i2c_hz = i2c_hz;
+    burn_stats.start_ms = hal_millis();
+    burn_retry_ms = burn_stats.start_ms - FV1_EEP_DETECT_RETRY_MS; // first try right away
+    FV1_WIRE.begin();
+    FV1_WIRE.setClock(i2c_hz);
+    Serial.println(F("Detecting EEPROM..."));
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::burn_cancel(void)
+{
+    if (burn_busy())
+        burn_finish(FV1_BURN_CANCELED);
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::burn_busy(void)
+{
+    return (burn_stats.state == FV1_BURN_DETECT || burn_stats.state == FV1_BURN_WRITE || burn_stats.state == FV1_BURN_VERIFY);
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::burn_process(void)
+{
+    uint8_t page[FV1_EEP_PAGE_SIZE];
+    uint32_t now = hal_millis();
+    uint32_t addr = burn_page * FV1_EEP_PAGE_SIZE;
+
+    switch (burn_stats.state)
     {
-        String data = hexfile.readStringUntil('\n'); // get a new line
-        data.trim();
-        if (data[0] != IHEX_START)
+    case FV1_BURN_DETECT:
+        if (now - burn_retry_ms < FV1_EEP_DETECT_RETRY_MS)
+            break;
+        burn_retry_ms = now;
+        if (eep.begin(burn_addr, FV1_WIRE))
         {
-            hexfile.close();
-            boot_complete = 1;
-            return FV1_INPUT_FILE_WRONG;
+            Serial.println(F("Writing EEPROM..."));
+            burn_stats.state = FV1_BURN_WRITE;
         }
-        // each line is one FV1 instruction,
-        data.getBytes(buffer, data.length()+1); // convert to byte array
-        type = get_record_type(buffer);
-        byte_count = get_record_length(buffer);
-        chksum = get_record_chksum(buffer);
-        data_addr = get_record_address(buffer);
-        sum = byte_count + (data_addr >> 8) + (data_addr & 0xFF) + chksum + type;
-        //Serial.printf("addr = %04d, cnt = %04d\r\n", data_addr, byte_count);
-        switch (type)
+        else if (now - burn_stats.start_ms >= FV1_EEP_DETECT_MS)
         {
-        case 0x00: // data byte
-            sum += extract_data(buffer, byte_count, &dsp_fw_bf[data_addr]);
+            Serial.println(F("No memory detected."));
+            burn_finish(FV1_BURN_ERROR);
+        }
+        break;
+    case FV1_BURN_WRITE:
+    {
+        bool same = false;
+        if (!eep.waitForWriteComplete())
+        {
+            Serial.println(F("EEPROM not responding."));
+            burn_finish(FV1_BURN_ERROR);
             break;
-        case 0x01: // end of file
-            eof_reached = true;
+        }
+        // pages already holding the image are not rewritten, saves time and EEPROM wear,
+        // a page written again after a failed verify is known to differ
+        if (!burn_force && !burn_retries[burn_page])
+        {
+            eep.read(addr, page, FV1_EEP_PAGE_SIZE);
+            same = !memcmp(page, &dsp_fw_bf[addr], FV1_EEP_PAGE_SIZE);
+        }
+        if (same)
+        {
+            burn_stats.pages_skipped++;
+            burn_stats.bytes_verified += FV1_EEP_PAGE_SIZE;
+            burn_next_page();
             break;
-        default:
-            hexfile.close();
-            boot_complete = 1;
-            return FV1_INPUT_FILE_WRONG;
+        }
+        if (!burn_retries[burn_page])
+            burn_stats.pages_written++;
+        burn_stats.bytes_written += FV1_EEP_PAGE_SIZE;
+        if (burn_stats.page_write)
+        {
+            if (!eep.writePage(addr, &dsp_fw_bf[addr], FV1_EEP_PAGE_SIZE))
+            {
+                Serial.printf(PSTR("Page write failed at 0x%04x\n"), addr);
+                burn_retry_page();
+                break;
+            }
+        }
+        else
+        {
+            eep.write(addr, &dsp_fw_bf[addr], FV1_EEP_PAGE_SIZE);
+        }
+        burn_write_ms = hal_millis();   // the write cycle starts after the transfer, ~3 ms at 100 kHz
+        burn_stats.state = FV1_BURN_VERIFY;
+        break;
+    }
+    case FV1_BURN_VERIFY:
+        // read the page back as soon as its write cycle is over, until then serve the others
+        if (eep.isBusy())
+        {
+            if (now - burn_write_ms > 2u * eep.getPageWriteTime())
+            {
+                Serial.println(F("EEPROM not responding."));
+                burn_finish(FV1_BURN_ERROR);
+            }
             break;
         }
-        if (sum & 0xFF) // checksum mismatch!
+        if (!eep_verify_page(burn_page))
         {
-            hexfile.close();
-            boot_complete = 1;
-            return FV1_INPUT_FILE_CHKSUM_ERR;
+            burn_retry_page();
+            break;
         }
+        burn_stats.bytes_verified += FV1_EEP_PAGE_SIZE;
+        burn_next_page();
+        break;
+    default:
+        break;
     }
-    if (!eof_reached)
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::burn_next_page(void)
+{
+    if (++burn_page == FV1_EEP_PAGES)
+        burn_finish(FV1_BURN_DONE);
+    else
+        burn_stats.state = FV1_BURN_WRITE;
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::burn_retry_page(void)
+{
+    if (++burn_retries[burn_page] > FV1_EEP_RETRIES)
     {
-        hexfile.close();
-        boot_complete = 1;
-        return FV1_INPUT_FILE_WRONG;
+        burn_stats.failed_page = burn_page;
+        burn_finish(FV1_BURN_ERROR);
+        return;
     }
-    current_program = 0;
-    dsp_fw_ptr = &dsp_fw_bf[512 * current_program];
-    hexfile.close();
-    if (boot_complete)      // do not save at boot
+    burn_stats.retries++;
+    burn_stats.state = FV1_BURN_WRITE;   // write the same page again
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::burn_finish(fv1_burn_state_t state)
+{
+    burn_stats.state = state;
+    burn_stats.burn_ms = hal_millis() - burn_stats.start_ms;
+    if (state == FV1_BURN_DONE)          Serial.println(F("EEPROM write success!"));
+    else if (state == FV1_BURN_CANCELED) Serial.println(F("EEPROM write canceled!"));
+    else                                 Serial.println(F("EEPROM write error!"));
+    Serial.printf(PSTR("%u pages written, %u skipped, %u ms (%s, %u kHz)\n"), burn_stats.pages_written, burn_stats.pages_skipped,
+                  burn_stats.burn_ms, burn_stats.page_write ? "page" : "chunk", burn_stats.i2c_hz / 1000);
+    if (prod_stats.state == FV1_PROD_OFF)
+        slave_init(); // reinit the slave i2c
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::eep_open(uint8_t slaveAddr)
+{
+    // the lines are shared with the slave i2c, not while a burn or production run owns them
+    if (burn_busy() || prod_stats.state != FV1_PROD_OFF)
+        return false;
+    FV1_WIRE.begin();
+    FV1_WIRE.setClock(FV1_EEP_I2C_HZ);
+    if (!eep.begin(slaveAddr, FV1_WIRE))
     {
-        File last_used = LittleFS.open("/htm/last.ini", "w");
-        last_used.print(path);
-        last_used.close();       
+        slave_init();
+        return false;
     }
-    boot_complete = 1;
-    return FV1_OK;
+    return true;
 }
 // -----------------------------------------------------------------------------------------------------
-bool FV1::write_eep(uint8_t slaveAddr)
+void FV1::eep_read(uint32_t addr, uint8_t *buf, uint16_t len)
 {
-    bool result = false;
-    Wire.begin();
-    if (dsp_fw_ptr)
+    eep.read(addr, buf, len);   // sequential reads, split to the I2C rx buffer size by the library
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::eep_close(void)
+{
+    slave_init();
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::eep_prg_crc(uint8_t slaveAddr, uint32_t *crc)
+{
+    uint8_t buf[FV1_EEP_READ_BURST];
+
+    if (!eep_open(slaveAddr))
+        return false;
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
     {
-        while (eep.begin(0x51) == false)
+        uint32_t c = CRC32_INIT;
+        for (uint16_t pos = 0; pos < FV1_PRG_SIZE; pos += sizeof(buf))
         {
-            Serial.println(F("No memory detected."));
-            delay(250);
+            eep.read(FV1_PRG_SIZE * i + pos, buf, sizeof(buf));
+            c = crc32_update(c, buf, sizeof(buf));
         }
+        crc[i] = crc32_final(c);
+    }
+    eep_close();
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FV1::prod_start(void)
+{
+    if (!dsp_fw_ptr || burn_busy())
+        return false;
+    if (prod_stats.state != FV1_PROD_OFF)
+        return true;
+    memset(&prod_stats, 0, sizeof(prod_stats));
+    prod_stats.state = FV1_PROD_WAIT_CHIP;
+    prod_stats.start_ms = hal_millis();
+    prod_poll_ms = prod_stats.start_ms;
+    prod_debounce = 0;
+    hal_pin_mode(FV1_PROD_LED_PIN, OUTPUT);
+    prod_led(prod_stats.start_ms);
+    FV1_WIRE.begin();
+    FV1_WIRE.setClock(FV1_EEP_I2C_HZ);
+    Serial.println(F("Production mode: insert EEPROM"));
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::prod_stop(void)
+{
+    if (prod_stats.state == FV1_PROD_OFF)
+        return;
+    burn_cancel();
+    prod_stats.state = FV1_PROD_OFF;
+    prod_led(hal_millis());
+    slave_init();
+    Serial.println(F("Production mode off"));
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::prod_process(void)
+{
+    uint32_t now = hal_millis();
 
-        Serial.println(F("Writing EEPROM..."));
-        eep.write(0x00, dsp_fw_bf, sizeof(dsp_fw_bf));
-        Serial.println(F("Veryfing EEPROM..."));
-        result = eep_verify();
+    prod_led(now);
+    if (prod_stats.state == FV1_PROD_BURN)
+    {
+        // burn_process() finished the burn
+        if (burn_stats.state != FV1_BURN_CANCELED)
+        {
+            prod_stats.last_pass = (burn_stats.state == FV1_BURN_DONE);
+            prod_stats.chips++;
+            if (!prod_stats.last_pass)
+                prod_stats.failed++;
+            prod_stats.burn_ms_total += burn_stats.burn_ms;
+        }
+        Serial.printf(PSTR("Production mode: %s, %u chips, %u failed\n"), prod_stats.last_pass ? "PASS" : "FAIL",
+                      prod_stats.chips, prod_stats.failed);
+        prod_stats.state = FV1_PROD_WAIT_REMOVE;
+        prod_debounce = 0;
+        return;
     }
-    else
+    if (now - prod_poll_ms < FV1_PROD_POLL_MS)
+        return;
+    prod_poll_ms = now;
+    // a chip has to be seen (or missing) a few times in a row, contacts bounce while it is inserted
+    bool present = eep.isConnected(FV1_EEP_ADDR);
+    if (present != (prod_stats.state == FV1_PROD_WAIT_CHIP))
     {
-        result = false;
+        prod_debounce = 0;
+        return;
     }
-    if (result) Serial.println(F("EEPROM write success!"));
-    else        Serial.println(F("EEPROM write error!"));
-    begin(); // reinit the slave i2c
-
-    return result;
+    if (++prod_debounce < FV1_PROD_DEBOUNCE)
+        return;
+    prod_debounce = 0;
+    if (prod_stats.state == FV1_PROD_WAIT_REMOVE)
+    {
+        prod_stats.state = FV1_PROD_WAIT_CHIP;
+        Serial.println(F("Production mode: insert EEPROM"));
+    }
+    else if (burn_start(FV1_EEP_ADDR))
+    {
+        prod_stats.state = FV1_PROD_BURN;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1::prod_led(uint32_t now)
+{
+    bool on = false;
+    if (prod_stats.state == FV1_PROD_BURN)
+        on = (now / 250) & 1;
+    else if (prod_stats.state == FV1_PROD_WAIT_REMOVE)
+        on = prod_stats.last_pass ? true : (now / 100) & 1;
+    hal_pin_write(FV1_PROD_LED_PIN, on ? LOW : HIGH);
 }
 // -----------------------------------------------------------------------------------------------------
 void FV1::print_result(FV1_result_t result)
@@ -265,206 +772,146 @@ void FV1::print_result(FV1_result_t result)
     }
 }
 // -----------------------------------------------------------------------------------------------------
-uint8_t FV1::get_record_length(uint8_t *record)
-{
-    char buf[3];
-
-    buf[0] = record[1];
-    buf[1] = record[2];
-    buf[2] = '\0';
-
-    return strtol(buf, 0, 16);
-}
-// -----------------------------------------------------------------------------------------------------
-uint16_t FV1::get_record_address(uint8_t *record)
-{
-    char buf[3];
-    uint16_t addr;
-    buf[2] = '\0';
-
-    buf[0] = record[3];
-    buf[1] = record[4];
-    addr = (strtol(buf, 0, 16)) << 8;
-
-    buf[0] = record[5];
-    buf[1] = record[6];
-    addr += strtol(buf, 0, 16);
-
-    return addr;
-}
-// -----------------------------------------------------------------------------------------------------
-uint8_t FV1::get_record_type(uint8_t *record)
-{
-    char buf[3];
-
-    buf[0] = record[7];
-    buf[1] = record[8];
-    buf[2] = '\0';
-
-    return strtol(buf, 0, 16);
-}
-// -----------------------------------------------------------------------------------------------------
-uint8_t FV1::get_record_chksum(uint8_t *record)
+static void sda_stream_encode(const uint8_t *dataPtr, uint32_t *stream)
 {
-    char buf[3];
-    uint8_t addr = 9 + get_record_length(record) * 2;
-
-    buf[0] = record[addr];
-    buf[1] = record[addr + 1];
-    buf[2] = '\0';
+    uint32_t word = 0;
+    uint8_t bits = 0;
 
-    return strtol(buf, 0, 16);
-}
-// -----------------------------------------------------------------------------------------------------
-uint16_t FV1::extract_data(uint8_t *record, uint16_t len, uint8_t *rawBufPtr)
-{
-    int begin = 9;               // start position of data in record
-    int end = (len * 2) + begin; //data is in sets of 2
-    char buf[3];
-    buf[2] = '\0';
-    uint8_t value;
-    uint16_t sum = 0;
-    for (int i = begin; i < end; i = i + 2)
+    for (uint16_t pos = 0; pos < FV1_PRG_SIZE; pos++)
     {
-        buf[0] = record[i];
-        buf[1] = record[i + 1];
-        value = strtol(buf, 0, 16);
-        *rawBufPtr++ = value;
-        sum += value;
+        // 8 data bits MSB first, then SDA released for the master's ACK
+        uint16_t frame = (dataPtr[pos] << 1) | 1;
+        for (int8_t i = I2C_BYTE_CLOCKS - 1; i >= 0; i--)
+        {
+            word = (word << 1) | ((frame >> i) & 1);
+            if (++bits == 32)
+            {
+                *stream++ = word;
+                word = 0;
+                bits = 0;
+            }
+        }
     }
-    return sum;
 }
-
 // -----------------------------------------------------------------------------------------------------
-bool IRAM_ATTR trig_read(uint8_t *dataPtr, uint8_t rst)
+bool IRAM_ATTR trig_read(const uint32_t *stream, uint8_t rst, uint32_t pulse_cycles, uint32_t start_cycles, uint32_t idle_cycles)
 {
-    volatile uint32_t dly = 20000;
     uint8_t prev_clk = 1;
 
-    uint16_t pos = 0;
-    uint8_t curr_byte = *dataPtr;
+    uint16_t edge = 0;
+    uint32_t levels = *stream;
 
-    uint8_t bit_mask = 0b10000000;
     uint8_t clk_count = 0;
-    uint32_t timeout = I2C_SLAVE_TIMEOUT_TICKS;
-    GPEC = (1 << SDA) | (1 << SCL);
+    uint32_t iters = 0;
+    HAL_SDA_RELEASE();
+    HAL_SCL_RELEASE();
     // Undivided attention for FV-1 requests
-    noInterrupts();
+    hal_irq_disable();
 
     // Notify FV-1 of patch change by toggling the notify pin
-    digitalWrite(rst, LOW);
-    while (dly)
-    {
-        dly--;
-        __asm__ __volatile__("nop");
-        ESP.wdtFeed();
-    }
-    GPEC = (1 << SDA);
-    digitalWrite(rst, HIGH);
+    hal_pin_write(rst, LOW);
+    uint32_t start_t = hal_cycles();
+    while (hal_cycles() - start_t < pulse_cycles)
+        hal_wdt_feed();
+    HAL_SDA_RELEASE();
+    hal_pin_write(rst, HIGH);
+    start_t = hal_cycles();
+    uint32_t last_t = start_t;          // last SCL change
+    uint32_t idle_limit = start_cycles; // the FV-1 needs longer for the first edge
+#ifdef FV1_EDGE_STATS
+    uint32_t edge_t = start_t;
+#endif
 
-    while (clk_count < 37 && --timeout) // Handle the header
+    while (clk_count < I2C_HDR_CLOCKS) // Handle the header
     {
-        uint8_t clk = (GPI & (1 << SCL)) != 0; // read SCL
+        uint8_t clk = HAL_SCL_READ(); // read SCL
+        uint32_t now = hal_cycles();
+        EDGE_STATS_POLL(clk, now);
+        iters++;
+        if (clk != prev_clk)
+        {
+            last_t = now;
+            idle_limit = idle_cycles;
+        }
+        else if (now - last_t > idle_limit)
+            break;
         if (!clk && prev_clk)
         { // SCL went down
             switch (clk_count)
             {
-            case 8:
-            case 17:
-            case 26:
-            case 36:
-                GPES = (1 << SDA); // SDA low
+            case I2C_HDR_ACK_ADDR_W:
+            case I2C_HDR_ACK_PTR_H:
+            case I2C_HDR_ACK_PTR_L:
+            case I2C_HDR_ACK_ADDR_R:
+                HAL_SDA_LOW(); // SDA low
                 break;
             default:
-                GPEC = (1 << SDA); // SDA high
+                HAL_SDA_RELEASE(); // SDA high
                 break;
             }
+            EDGE_STATS_EDGE();
             clk_count++;
         }
         prev_clk = clk;
     }
-    timeout = I2C_SLAVE_TIMEOUT_TICKS;
-    clk_count = 0;
-    while (pos < 512 && --timeout) // Send the data
+    edge_stats.hdr_iters = iters;
+    iters = 0;
+    while (clk_count == I2C_HDR_CLOCKS && edge < I2C_DATA_CLOCKS) // Send the data
     {
-        uint8_t clk = (GPI & (1 << SCL)) != 0; // read SCL
-
-        if (!clk && prev_clk) // falling edge
+        uint8_t clk = HAL_SCL_READ(); // read SCL
+        uint32_t now = hal_cycles();
+        EDGE_STATS_POLL(clk, now);
+        iters++;
+        if (clk != prev_clk)
+            last_t = now;
+        else if (now - last_t > idle_cycles)
+            break;
+        if (!clk && prev_clk) // falling edge, output the next precomputed level
         {
-            if (clk_count != 8) // Sending byte
-            {
-                if (curr_byte & bit_mask)
-                    GPEC = (1 << SDA); //SDA_HIGH(SDA);
-                else
-                    GPES = (1 << SDA); //SDA_LOW(SDA);
-                bit_mask >>= 1;
-                clk_count++;
-            }
-            else
-            {
-                GPEC = (1 << SDA); // SDA_HIGH(SDA);
-                clk_count = 0;
-                bit_mask = 0b10000000;
-                pos++;
-                curr_byte = *(++dataPtr);
-            }
+            HAL_SDA_WRITE(levels >> 31);
+            EDGE_STATS_EDGE();
+            levels <<= 1;
+            if (!(++edge & 31))
+                levels = *(++stream);
         }
         prev_clk = clk;
-        ESP.wdtFeed();
+        hal_wdt_feed();
     }
-    interrupts();
-    if (timeout)
-        return true;
-    else
-        return false;
+    HAL_SDA_RELEASE();  // do not leave the bus held after an aborted transfer
+    hal_irq_enable();
+    bool result = (edge == I2C_DATA_CLOCKS);
+    edge_stats.last_cycles = hal_cycles() - start_t;
+    edge_stats.data_iters = iters;
+    if (edge_stats.last_cycles > edge_stats.max_cycles)
+        edge_stats.max_cycles = edge_stats.last_cycles;
+    edge_stats.transfers++;
+    if (!result)
+        edge_stats.timeouts++;
+    return result;
 }
 // -----------------------------------------------------------------------------------------------------
-bool FV1::eep_verify(void)
+bool FV1::eep_verify_page(uint16_t page)
 {
-    if (!dsp_fw_ptr)
-    {
-        Serial.print(F("Verification error! HEX file not enabled!'"));
-        return (false);
-    }
-
-    int error = 0;
-    uint32_t EEPROMLocation = 0;
-    uint8_t *onEEPROM = (uint8_t *)malloc(eep.getPageSize()); //Create a buffer to hold a page
+    uint8_t onEEPROM[FV1_EEP_PAGE_SIZE];
+    uint32_t EEPROMLocation = page * FV1_EEP_PAGE_SIZE;
 
-    while (EEPROMLocation < 4096)
+    eep.read(EEPROMLocation, onEEPROM, FV1_EEP_PAGE_SIZE); //Location, data
+    //Verify what was read from the EEPROM matches the file
+    for (uint8_t x = 0; x < FV1_EEP_PAGE_SIZE; x++)
     {
-        ESP.wdtFeed();
-        uint8_t bytesToRead = eep.getPageSize();
-
-        if (EEPROMLocation + bytesToRead > eep.getMemorySize())
-            bytesToRead = eep.getMemorySize() - EEPROMLocation;
-
-        eep.read(EEPROMLocation, onEEPROM, eep.getPageSize()); //Location, data
-        //Verify what was read from the EEPROM matches the file
-        for (int x = 0; x < bytesToRead; x++)
+        uint8_t onFile = dsp_fw_bf[EEPROMLocation + x];
+        if (onEEPROM[x] != onFile)
         {
-            uint8_t onFile = dsp_fw_bf[EEPROMLocation + x];
-            if (onEEPROM[x] != onFile)
-            {
-                Serial.print(F("Verify failed at location 0x"));
-                Serial.print(EEPROMLocation + x, HEX);
-                Serial.print(F(". Read 0x"));
-                Serial.print(onEEPROM[x], HEX);
-                Serial.print(F(", expected 0x"));
-                Serial.print(onFile, HEX);
-                Serial.println(F("."));
-                if (error++)
-                {
-                    return (false);
-                }
-            }
+            Serial.print(F("Verify failed at location 0x"));
+            Serial.print(EEPROMLocation + x, HEX);
+            Serial.print(F(". Read 0x"));
+            Serial.print(onEEPROM[x], HEX);
+            Serial.print(F(", expected 0x"));
+            Serial.print(onFile, HEX);
+            Serial.println(F("."));
+            return (false);
         }
-        EEPROMLocation += bytesToRead;
-        if (EEPROMLocation % (eep.getPageSize()*16) == 0)
-            Serial.print(F("."));
     }
-    Serial.println(F("\r\nVerification PASSED!"));
-    free(onEEPROM);
     return (true);
 }
 
@@ -20,6 +20,18 @@
 
 #include <Arduino.h>
 #include <LittleFS.h>
+#include "ihex.h"
+#include "fv1_cache.h"
+
+#define FV1_PRG_COUNT       (8u)
+#define FV1_PRG_SIZE        (512u)          // 128 instructions x 4 bytes
+#define FV1_IMAGE_SIZE      (FV1_PRG_COUNT * FV1_PRG_SIZE)
+#define FV1_IMAGE_EXT       ".fv1img"       // decoded image stored next to the hex file, not a user file type
+#define FV1_IMAGE_MAGIC     (0x45315646u)   // "FV1E"
+
+#define FV1_EEP_ADDR        (0x51u)         // onboard/socketed EEPROM, A0 pulled high
+#define FV1_EEP_PAGE_SIZE   (32u)           // 24LC32A write page
+#define FV1_EEP_PAGES       (FV1_IMAGE_SIZE / FV1_EEP_PAGE_SIZE)
 
 typedef enum
 {
@@ -30,6 +42,134 @@ typedef enum
     FV1_OTHER_ERR
 }FV1_result_t;
 
+typedef struct
+{
+    uint32_t magic;
+    uint32_t src_size;      // size of the source hex file
+    uint32_t src_mtime;     // last write time of the source hex file
+    uint32_t prg_mask;      // programs present in the source file
+    uint32_t prg_crc[FV1_PRG_COUNT];    // CRC32 of each program
+}fv1_image_hdr_t;
+
+// Program transfer statistics. Transfer time and poll loop usage are always recorded,
+// the per edge latency histogram only in builds with -DFV1_EDGE_STATS.
+#define FV1_EDGE_STATS_BUCKETS      (16u)
+#define FV1_EDGE_STATS_SHIFT        (4u)    // 16 CPU cycles per histogram bucket
+
+typedef struct
+{
+    uint32_t transfers;
+    uint32_t timeouts;
+    uint32_t last_cycles;       // reset release to the last data clock
+    uint32_t max_cycles;
+    uint32_t hdr_iters;         // poll loop iterations used by the last transfer
+    uint32_t data_iters;
+    uint32_t edge_max;          // worst SCL high sample to SDA update, CPU cycles
+    uint32_t edge_hist[FV1_EDGE_STATS_BUCKETS];
+}fv1_edge_stats_t;
+
+// EEPROM burn, advanced one page per loop() call by FV1::process()
+#ifndef FV1_EEP_DETECT_MS
+#define FV1_EEP_DETECT_MS           (3000u)     // give up if no EEPROM answers for that long
+#endif
+#define FV1_EEP_DETECT_RETRY_MS     (250u)
+#define FV1_EEP_RETRIES             (3u)        // writes of a page failing the read back
+#ifndef FV1_EEP_I2C_HZ
+#define FV1_EEP_I2C_HZ              (400000u)   // 24LC32A fast mode
+#endif
+
+typedef enum
+{
+    FV1_BURN_IDLE,
+    FV1_BURN_DETECT,
+    FV1_BURN_WRITE,             // compare a page and write it if it differs
+    FV1_BURN_VERIFY,            // read the written page back
+    FV1_BURN_DONE,
+    FV1_BURN_ERROR,
+    FV1_BURN_CANCELED
+}fv1_burn_state_t;
+
+typedef struct
+{
+    fv1_burn_state_t state;
+    bool page_write;            // whole pages with ACK polling, else the library's chunked write
+    uint32_t i2c_hz;
+    uint32_t start_ms;
+    uint32_t burn_ms;           // detect, compare, write and verify
+    uint32_t bytes_written;
+    uint32_t bytes_verified;
+    uint32_t pages_written;
+    uint32_t pages_skipped;     // already matching the image
+    uint32_t retries;           // page writes repeated after a failed read back
+    int16_t failed_page;        // page that could not be written, -1 = none
+}fv1_burn_stats_t;
+
+// Production mode: burn every EEPROM put into the socket without using the web interface.
+// A new chip is detected by polling its address, the result is shown on the LED until it is removed.
+#ifndef FV1_PROD_LED_PIN
+#define FV1_PROD_LED_PIN            LED_BUILTIN // active low
+#endif
+#define FV1_PROD_POLL_MS            (100u)
+#define FV1_PROD_DEBOUNCE           (3u)        // equal polls needed to accept an insert/removal
+
+typedef enum
+{
+    FV1_PROD_OFF,
+    FV1_PROD_WAIT_CHIP,         // LED off
+    FV1_PROD_BURN,              // LED blinks slowly
+    FV1_PROD_WAIT_REMOVE        // LED on: pass, blinks fast: fail
+}fv1_prod_state_t;
+
+typedef struct
+{
+    fv1_prod_state_t state;
+    bool last_pass;
+    uint32_t start_ms;
+    uint32_t chips;
+    uint32_t failed;
+    uint32_t burn_ms_total;
+}fv1_prod_stats_t;
+
+// Program transfer timing in microseconds, converted to CPU cycles at run time so it does not
+// depend on the CPU clock. Defaults can be overridden per pedal with build flags or on /timing.
+#ifndef FV1_RST_PULSE_US
+#define FV1_RST_PULSE_US            (100u)      // first notify pulse tried
+#endif
+#ifndef FV1_RST_PULSE_MAX_US
+#define FV1_RST_PULSE_MAX_US        (6400u)     // pulse is doubled on timeout up to this length
+#endif
+#ifndef FV1_SCL_START_US
+#define FV1_SCL_START_US            (5000u)     // reset release to the first SCL edge
+#endif
+#ifndef FV1_SCL_IDLE_US
+#define FV1_SCL_IDLE_US             (1000u)     // transfer is aborted if SCL stays idle longer
+#endif
+
+typedef struct
+{
+    uint32_t rst_pulse_us;      // shortest pulse the FV-1 responded to so far
+    uint32_t rst_pulse_min_us;
+    uint32_t rst_pulse_max_us;
+    uint32_t start_us;
+    uint32_t idle_us;
+    uint32_t retries;           // transfers repeated with a longer pulse
+}fv1_timing_t;
+
+// Program switch requested by the web interface. Requests are only queued by the http
+// handlers and executed by process() from loop(), a newer request replaces a pending one.
+typedef struct
+{
+    uint32_t req_seq;           // incremented by every request
+    uint32_t done_seq;          // request the result below belongs to, 0 = none yet
+    uint32_t coalesced;         // requests replaced before they were executed
+    String req_path;            // program picked from this file, empty = enabled bank
+    String done_path;
+    uint8_t req_prg;
+    uint8_t done_prg;
+    bool pending;
+    bool done_ok;
+}fv1_prg_request_t;
+
 class FV1
 {
 public:
@@ -37,25 +177,77 @@ public:
     String begin();
     FV1_result_t load_file(const String& path);
     bool set_prg(uint8_t prg_no);
+    bool set_prg(const String &path, uint8_t prg_no);
+    uint32_t request_prg(uint8_t prg_no);
+    uint32_t request_prg(const String &path, uint8_t prg_no);
+    void process(void);
+    const fv1_prg_request_t &get_prg_request(void) {return prg_req;}
     void print_result(FV1_result_t result);
-    bool write_eep(uint8_t slaveAddr);
+    bool burn_start(uint8_t slaveAddr, uint32_t i2c_hz = FV1_EEP_I2C_HZ, bool page_write = true, bool force = false);
+    void burn_cancel(void);
+    bool burn_busy(void);
+    const fv1_burn_stats_t &get_burn_stats(void) {return burn_stats;}
+    uint8_t get_burn_retries(uint16_t page) {return burn_retries[page];}
+    bool eep_open(uint8_t slaveAddr);
+    void eep_read(uint32_t addr, uint8_t *buf, uint16_t len);
+    void eep_close(void);
+    bool eep_prg_crc(uint8_t slaveAddr, uint32_t *crc);
+    uint32_t get_prg_crc(uint8_t prg_no) {return prg_crc[prg_no];}
+    bool get_fw_loaded(void) {return dsp_fw_ptr != NULL;}
+    bool prod_start(void);
+    void prod_stop(void);
+    const fv1_prod_stats_t &get_prod_stats(void) {return prod_stats;}
     bool toggle_slave_i2c();
     bool get_slave_i2c_state(void) {return slave_i2c_state;}
+    static FV1_result_t decode_result(ihex_result_t reply, uint8_t prg_mask);
+    static String image_path(const String &path);
+    static bool is_image_path(const String &path);
+    static bool save_image(const String &path, const uint8_t *image, uint8_t prg_mask);
+    uint32_t get_image_hits(void) {return image_hits;}
+    uint32_t get_image_misses(void) {return image_misses;}
+    FV1Cache &get_cache(void) {return ram_cache;}
+    void drop_cache(const String &path) {ram_cache.drop(path);}
+    const fv1_edge_stats_t &get_edge_stats(void);
+    const fv1_timing_t &get_timing(void) {return timing;}
+    void set_timing(uint32_t pulse_min_us, uint32_t pulse_max_us, uint32_t start_us, uint32_t idle_us);
 private:
     uint8_t dsprst_pin;
     uint8_t eep_select_pin;
     uint8_t current_program;
     uint8_t *dsp_fw_ptr;
-    uint8_t dsp_fw_bf[4096];
+    uint8_t dsp_fw_bf[FV1_IMAGE_SIZE];
+    uint8_t prg_bf[FV1_PRG_SIZE];       // single program picked from a not enabled file
+    uint32_t prg_crc[FV1_PRG_COUNT] = {};   // CRC32 of each program in dsp_fw_bf
     uint8_t slave_i2c_state = 1;
     uint8_t boot_complete = 0;
-    uint8_t get_record_length(uint8_t* record);
-    uint16_t get_record_address(uint8_t* record);
-    uint8_t get_record_type(uint8_t* record);
-    uint16_t extract_data(uint8_t* record, uint16_t len, uint8_t *rawBufPtr);
-    uint8_t get_record_chksum(uint8_t* record);
-    bool parse_record(uint8_t* record);
-    bool eep_verify(void);
+    uint32_t image_hits = 0;
+    uint32_t image_misses = 0;
+    FV1Cache ram_cache{FV1_IMAGE_SIZE};
+    fv1_prg_request_t prg_req = {};
+    fv1_burn_stats_t burn_stats = {};
+    uint8_t burn_addr;
+    bool burn_force;            // write all pages, even the matching ones
+    uint16_t burn_page;
+    uint32_t burn_retry_ms;
+    uint32_t burn_write_ms;     // start of the current page write cycle
+    uint8_t burn_retries[FV1_EEP_PAGES];
+    void burn_process(void);
+    void burn_next_page(void);
+    void burn_retry_page(void);
+    void burn_finish(fv1_burn_state_t state);
+    fv1_prod_stats_t prod_stats = {};
+    uint32_t prod_poll_ms;
+    uint8_t prod_debounce;
+    void prod_process(void);
+    void prod_led(uint32_t now);
+    void slave_init(void);
+    fv1_timing_t timing = {FV1_RST_PULSE_US, FV1_RST_PULSE_US, FV1_RST_PULSE_MAX_US, FV1_SCL_START_US, FV1_SCL_IDLE_US, 0};
+    bool transfer(const uint8_t *prg);
+    FV1_result_t decode_file(File &hexfile, uint8_t *image, uint8_t &prg_mask);
+    bool load_image(const String &path, File &hexfile, uint8_t *image, uint8_t &prg_mask);
+    bool load_image_prg(const String &path, File &hexfile, uint8_t prg_no, uint8_t *dst);
+    bool check_image_hdr(File &imgfile, File &hexfile, fv1_image_hdr_t &hdr);
+    bool eep_verify_page(uint16_t page);
     void print_file(void);
 };
 
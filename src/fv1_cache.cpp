@@ -0,0 +1,159 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fv1_cache.h"
+
+// -----------------------------------------------------------------------------------------------------
+FV1Cache::FV1Cache(uint32_t image_size, uint32_t budget)
+{
+    img_size = image_size;
+    this->budget = budget;
+    for (auto &e : entry)
+        e.image = NULL;
+}
+// -----------------------------------------------------------------------------------------------------
+const uint8_t *FV1Cache::get(const String &path, uint32_t size, uint32_t mtime, uint8_t &prg_mask)
+{
+    fv1_cache_entry_t *e = find(key(path));
+    if (!e || e->size != size || e->mtime != mtime)
+    {
+        misses++;
+        return NULL;
+    }
+    e->last_use = ++use_tick;
+    prg_mask = e->prg_mask;
+    hits++;
+    return e->image;
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1Cache::put(const String &path, uint32_t size, uint32_t mtime, const uint8_t *src, uint8_t prg_mask)
+{
+    String k = key(path);
+    fv1_cache_entry_t *e = find(k);
+    if (!max_entries())
+        return;
+    if (!e) // new file, take a free entry or the least recently used one
+    {
+        while (get_entries() >= max_entries())
+            evict(oldest());
+        for (auto &f : entry)
+        {
+            if (!f.image)
+            {
+                e = &f;
+                break;
+            }
+        }
+        if (ESP.getFreeHeap() < FV1_CACHE_MIN_FREE_HEAP + img_size)
+            trim();
+        if (ESP.getFreeHeap() < FV1_CACHE_MIN_FREE_HEAP + img_size)
+            return;
+        e->image = (uint8_t *)malloc(img_size);
+        if (!e->image)
+            return;
+        e->path = k;
+    }
+    e->size = size;
+    e->mtime = mtime;
+    e->prg_mask = prg_mask;
+    e->last_use = ++use_tick;
+    memcpy(e->image, src, img_size);
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1Cache::drop(const String &path)
+{
+    // a file rewritten within the same second keeps size and mtime, also everything below a folder
+    String k = key(path);
+    String folder = k + "/";
+    for (auto &e : entry)
+    {
+        if (e.image && (!k.length() || e.path == k || e.path.startsWith(folder)))
+            evict(&e);
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1Cache::set_budget(uint32_t budget)
+{
+    this->budget = budget;
+    while (get_entries() > max_entries())
+        evict(oldest());
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1Cache::trim(void)
+{
+    // give the memory back to the web and FTP servers
+    while (get_entries() && ESP.getFreeHeap() < FV1_CACHE_MIN_FREE_HEAP)
+        evict(oldest());
+}
+// -----------------------------------------------------------------------------------------------------
+uint8_t FV1Cache::get_entries(void)
+{
+    uint8_t n = 0;
+    for (auto &e : entry)
+    {
+        if (e.image)
+            n++;
+    }
+    return n;
+}
+// -----------------------------------------------------------------------------------------------------
+fv1_cache_entry_t *FV1Cache::find(const String &key)
+{
+    for (auto &e : entry)
+    {
+        if (e.image && e.path == key)
+            return &e;
+    }
+    return NULL;
+}
+// -----------------------------------------------------------------------------------------------------
+String FV1Cache::key(const String &path)
+{
+    // "folder/name", "/folder/name" and "//name" (root upload) are the same file
+    String k = path;
+    while (k.indexOf("//") >= 0)
+        k.replace("//", "/");
+    if (k.startsWith("/"))
+        k.remove(0, 1);
+    if (k.endsWith("/"))
+        k.remove(k.length() - 1);
+    return k;
+}
+// -----------------------------------------------------------------------------------------------------
+fv1_cache_entry_t *FV1Cache::oldest(void)
+{
+    fv1_cache_entry_t *old = NULL;
+    for (auto &e : entry)
+    {
+        if (e.image && (!old || e.last_use < old->last_use))
+            old = &e;
+    }
+    return old;
+}
+// -----------------------------------------------------------------------------------------------------
+void FV1Cache::evict(fv1_cache_entry_t *e)
+{
+    free(e->image);
+    e->image = NULL;
+    e->path = "";
+    evictions++;
+}
+// -----------------------------------------------------------------------------------------------------
+uint8_t FV1Cache::max_entries(void)
+{
+    uint32_t n = budget / img_size;
+    return n > FV1_CACHE_MAX_ENTRIES ? FV1_CACHE_MAX_ENTRIES : n;
+}
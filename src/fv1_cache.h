@@ -0,0 +1,77 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_CACHE_H
+#define _FV1_CACHE_H
+
+// LRU cache of decoded FV-1 banks kept in RAM.
+// Entries are keyed by file path + size + last write time, so a modified
+// file never hits an old entry. Paths are compared without leading, trailing
+// and doubled slashes: the pages, uploads and FTP spell the same file differently. Images are allocated on the heap within
+// a budget and released whenever the free heap drops below a threshold.
+// Pointers returned by get() are valid until the next put() or trim().
+
+#include <Arduino.h>
+
+#ifndef FV1_CACHE_BUDGET
+#define FV1_CACHE_BUDGET        (3u * 4096u)    // heap used for cached images
+#endif
+#ifndef FV1_CACHE_MIN_FREE_HEAP
+#define FV1_CACHE_MIN_FREE_HEAP (16384u)        // keep at least that much for the servers
+#endif
+#define FV1_CACHE_MAX_ENTRIES   (8u)
+
+typedef struct
+{
+    String path;
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t last_use;
+    uint8_t prg_mask;       // programs present in the file
+    uint8_t *image;         // NULL = unused entry
+}fv1_cache_entry_t;
+
+class FV1Cache
+{
+public:
+    FV1Cache(uint32_t image_size, uint32_t budget = FV1_CACHE_BUDGET);
+    const uint8_t *get(const String &path, uint32_t size, uint32_t mtime, uint8_t &prg_mask);
+    void put(const String &path, uint32_t size, uint32_t mtime, const uint8_t *src, uint8_t prg_mask);
+    void drop(const String &path);
+    void set_budget(uint32_t budget);
+    void trim(void);
+    uint8_t get_entries(void);
+    uint32_t get_budget(void) {return budget;}
+    uint32_t get_hits(void) {return hits;}
+    uint32_t get_misses(void) {return misses;}
+    uint32_t get_evictions(void) {return evictions;}
+private:
+    uint32_t img_size;
+    uint32_t budget;
+    uint32_t use_tick = 0;
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+    fv1_cache_entry_t entry[FV1_CACHE_MAX_ENTRIES];
+    fv1_cache_entry_t *find(const String &key);
+    static String key(const String &path);
+    fv1_cache_entry_t *oldest(void);
+    void evict(fv1_cache_entry_t *e);
+    uint8_t max_entries(void);
+};
+
+#endif // _FV1_CACHE_H
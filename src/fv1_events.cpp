@@ -0,0 +1,79 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fv1_events.h"
+#include "fv1_server.h"
+
+WiFiClient event_clients[EVENTS_MAX_CLIENTS];
+uint32_t event_keepalive_ms = 0;
+
+static void events_write(WiFiClient &client, const String &msg);
+
+// -----------------------------------------------------------------------------------------------------
+void events_subscribe(void)
+{
+    uint8_t slot = 0;
+    while (slot < EVENTS_MAX_CLIENTS && event_clients[slot].connected())
+        slot++;
+    if (slot == EVENTS_MAX_CLIENTS)
+    {
+        server.send(503, "text/plain", "Too many event clients!");
+        return;
+    }
+    // the connection is kept by the copy of the client, the web server moves on to the next request
+    WiFiClient client = server.client();
+    client.setNoDelay(true);
+    client.setSync(false);      // a write returns once the data is queued for sending
+    event_clients[slot] = client;
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.sendContent_P(PSTR("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n\r\n"));
+}
+// -----------------------------------------------------------------------------------------------------
+void events_send(const char *event, const String &data)
+{
+    String msg = (String) "event: " + event + "\ndata: " + data + "\n\n";
+    for (auto &client : event_clients)
+    {
+        if (client.connected())
+            events_write(client, msg);
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void events_process(void)
+{
+    if (millis() - event_keepalive_ms < EVENTS_KEEPALIVE_MS)
+        return;
+    event_keepalive_ms = millis();
+    for (auto &client : event_clients)
+    {
+        if (client.connected())
+            events_write(client, ": keepalive\n\n");
+        else if (client)
+            client.stop();
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+static void events_write(WiFiClient &client, const String &msg)
+{
+    // A page that does not read its events would hold loop() until the TCP timeout, also
+    // while a program is switched or the EEPROM burned. It is dropped, it reconnects by itself.
+    if (client.availableForWrite() < msg.length())
+    {
+        client.stop();
+        return;
+    }
+    client.write((const uint8_t *)msg.c_str(), msg.length());
+}
@@ -0,0 +1,34 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_EVENTS_H
+#define _FV1_EVENTS_H
+
+// Server-Sent Events push channel.
+// A GET to /events is kept open, the web page receives the state changes
+// (bank, program, burn, files, refresh) instead of polling for them.
+
+#include <Arduino.h>
+
+#define EVENTS_MAX_CLIENTS      (4u)
+#define EVENTS_KEEPALIVE_MS     (15000u)    // also drops the clients that went away
+
+void events_subscribe(void);
+void events_send(const char *event, const String &data);
+void events_process(void);
+
+#endif // _FV1_EVENTS_H
@@ -0,0 +1,67 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_HAL_H
+#define _FV1_HAL_H
+
+// Thin hardware abstraction used by the FV1 class.
+// All GPIO, clock, I2C and file system access of fv1.cpp goes through here,
+// a build for another target only has to provide this header.
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Wire.h>
+
+// also used from IRAM code (trig_read), must not end up as a flash function call
+#define HAL_INLINE              static inline __attribute__((always_inline))
+
+// file system and I2C master used for the EEPROM, a build can point them to other
+// instances of the same classes. TwoWire has no virtual methods on the ESP8266, an EEPROM
+// model can not be slipped in here; the native build links a TwoWire stand-in that passes
+// the transfers to device models instead (lib/fv1_native, eeprom_24lc32a.h).
+#ifndef FV1_FS
+#define FV1_FS                  LittleFS
+#endif
+#ifndef FV1_WIRE
+#define FV1_WIRE                Wire
+#endif
+
+// I2C slave lines, SDA is open drain: output latch is low, driving = enable output
+#define HAL_SCL_READ()          ((GPI & (1 << SCL)) != 0)
+#define HAL_SDA_LOW()           (GPES = (1 << SDA))
+#define HAL_SDA_RELEASE()       (GPEC = (1 << SDA))
+#define HAL_SCL_RELEASE()       (GPEC = (1 << SCL))
+#define HAL_SDA_LATCH_LOW()     (GPOC = (1 << SDA))
+// branchless SDA write, level 0 = drive low (GPES), 1 = release (GPEC, 4 bytes above GPES)
+#define HAL_SDA_WRITE(level)    (ESP8266_REG(0x310 + ((level) << 2)) = (1 << SDA))
+
+HAL_INLINE void hal_pin_mode(uint8_t pin, uint8_t mode)         {pinMode(pin, mode);}
+HAL_INLINE void hal_pin_write(uint8_t pin, uint8_t value)       {digitalWrite(pin, value);}
+
+// clock
+HAL_INLINE uint32_t hal_cycles(void)                            {return ESP.getCycleCount();}
+HAL_INLINE uint32_t hal_cpu_mhz(void)                           {return ESP.getCpuFreqMHz();}
+HAL_INLINE uint32_t hal_millis(void)                            {return millis();}
+HAL_INLINE uint32_t hal_micros(void)                            {return micros();}
+HAL_INLINE void hal_delay(uint32_t ms)                          {delay(ms);}
+
+// time critical sections
+HAL_INLINE void hal_irq_disable(void)                           {noInterrupts();}
+HAL_INLINE void hal_irq_enable(void)                            {interrupts();}
+HAL_INLINE void hal_wdt_feed(void)                              {ESP.wdtFeed();}
+
+#endif // _FV1_HAL_H
@@ -0,0 +1,253 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fv1_index.h"
+#include <LittleFS.h>
+#include "fv1.h"
+
+static uint8_t file_flags(const String &path, bool valid);
+static int cmp_part(const char *a, size_t alen, const char *b, size_t blen);
+
+// -----------------------------------------------------------------------------------------------------
+void FileIndex::begin(void)
+{
+    Dir dir = LittleFS.openDir("/");
+
+    entries.clear();
+    pool.clear();
+    while (dir.next())
+    {
+        if (dir.isDirectory())
+            scan_folder(dir.fileName());
+        else if (!FV1::is_image_path(dir.fileName()))
+            add(dir.fileName(), dir.fileSize(), file_flags(dir.fileName(), LittleFS.exists(FV1::image_path(dir.fileName()))));
+    }
+    changed();
+}
+// -----------------------------------------------------------------------------------------------------
+void FileIndex::update(const String &path, bool valid)
+{
+    // re-reads a single file or folder after it was written, deleted or renamed
+    String p = path;
+    while (p.startsWith("/"))
+        p.remove(0, 1);
+    while (p.endsWith("/"))
+        p.remove(p.length() - 1);
+    int slash = p.indexOf('/');
+    if (!p.length())
+    {
+        begin();
+        return;
+    }
+    if (p.indexOf('/', slash + 1) >= 0 || FV1::is_image_path(p)) // deeper levels are not indexed
+        return;
+    changed();
+
+    String name = p.substring(slash + 1);
+    Dir dir = LittleFS.openDir(slash < 0 ? String("/") : p.substring(0, slash));
+    while (dir.next())
+    {
+        if (dir.fileName() != name)
+            continue;
+        if (dir.isDirectory())
+        {
+            if (slash < 0)
+            {
+                remove_folder(p);
+                scan_folder(p);
+            }
+            return;
+        }
+        if (slash >= 0)
+            add(p.substring(0, slash + 1), 0, FILE_INDEX_DIR);
+        add(p, dir.fileSize(), file_flags(p, valid));
+        return;
+    }
+    // gone
+    int16_t i = find(p);
+    if (i >= 0)
+        remove(i);
+    if (slash < 0)
+        remove_folder(p);
+}
+// -----------------------------------------------------------------------------------------------------
+int16_t FileIndex::find(const String &path)
+{
+    const char *p = path.c_str();
+    while (*p == '/')
+        p++;
+    const char *slash = strchr(p, '/');
+    uint8_t name_pos = slash ? slash - p + 1 : 0;
+    uint16_t i = lower_bound(p, name_pos);
+    if (i < entries.size() && !cmp(p, name_pos, i))
+        return i;
+    return -1;
+}
+// -----------------------------------------------------------------------------------------------------
+int16_t FileIndex::step(const String &path, int8_t dir)
+{
+    // next or previous hex file in the listing order, wraps around
+    int32_t count = entries.size();
+    int32_t i = find(path);
+    if (i < 0)
+        i = dir > 0 ? -1 : count;
+    for (int32_t n = 0; n < count; n++)
+    {
+        i = (i + dir + count) % count;
+        if (entries[i].flags & FILE_INDEX_HEX)
+            return i;
+    }
+    return -1;
+}
+// -----------------------------------------------------------------------------------------------------
+bool FileIndex::match(uint16_t i, const String &pattern)
+{
+    // case-insensitive substring search in the file name
+    const char *name = get_name(i);
+    size_t len = pattern.length();
+    for (; *name; name++)
+    {
+        size_t n = 0;
+        while (n < len && name[n] && tolower(name[n]) == tolower(pattern[n]))
+            n++;
+        if (n == len)
+            return true;
+    }
+    return !len;
+}
+// -----------------------------------------------------------------------------------------------------
+String FileIndex::get_folder(uint16_t i)
+{
+    const file_index_entry_t &e = entries[i];
+    return e.name_pos ? String(get_path(i)).substring(0, e.name_pos - 1) : String();
+}
+// -----------------------------------------------------------------------------------------------------
+bool FileIndex::same_folder(uint16_t a, uint16_t b)
+{
+    return entries[a].name_pos == entries[b].name_pos && !strncmp(get_path(a), get_path(b), entries[a].name_pos);
+}
+// -----------------------------------------------------------------------------------------------------
+void FileIndex::changed(void)
+{
+    FSInfo fs_info;
+    LittleFS.info(fs_info);
+    used_bytes = fs_info.usedBytes;
+    total_bytes = fs_info.totalBytes;
+    generation++;
+}
+// -----------------------------------------------------------------------------------------------------
+int FileIndex::cmp(const char *path, uint8_t name_pos, uint16_t i)
+{
+    // folder first (root files on top), then the name, the same order as the web listing
+    const char *other = get_path(i);
+    uint8_t other_pos = entries[i].name_pos;
+    int res = cmp_part(path, name_pos ? name_pos - 1 : 0, other, other_pos ? other_pos - 1 : 0);
+    if (res)
+        return res;
+    return cmp_part(path + name_pos, strlen(path + name_pos), other + other_pos, strlen(other + other_pos));
+}
+// -----------------------------------------------------------------------------------------------------
+uint16_t FileIndex::lower_bound(const char *path, uint8_t name_pos)
+{
+    uint16_t lo = 0;
+    uint16_t hi = entries.size();
+    while (lo < hi)
+    {
+        uint16_t mid = (lo + hi) / 2;
+        if (cmp(path, name_pos, mid) > 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+// -----------------------------------------------------------------------------------------------------
+void FileIndex::add(const String &path, uint32_t size, uint8_t flags)
+{
+    uint8_t name_pos = path.indexOf('/') + 1;
+    uint16_t i = lower_bound(path.c_str(), name_pos);
+    if (i < entries.size() && !cmp(path.c_str(), name_pos, i))
+    {
+        entries[i].size = size;
+        entries[i].flags = flags;
+        return;
+    }
+    if (pool.size() + path.length() + 1 > UINT16_MAX)
+        return;
+    file_index_entry_t e;
+    e.path = pool.size();
+    e.name_pos = name_pos;
+    e.flags = flags;
+    e.size = size;
+    pool.insert(pool.end(), path.c_str(), path.c_str() + path.length() + 1);
+    entries.insert(entries.begin() + i, e);
+}
+// -----------------------------------------------------------------------------------------------------
+void FileIndex::remove(uint16_t i)
+{
+    uint16_t offset = entries[i].path;
+    uint16_t len = strlen(get_path(i)) + 1;
+    pool.erase(pool.begin() + offset, pool.begin() + offset + len);
+    entries.erase(entries.begin() + i);
+    for (auto &e : entries)
+    {
+        if (e.path > offset)
+            e.path -= len;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void FileIndex::remove_folder(const String &folder)
+{
+    for (int32_t i = entries.size() - 1; i >= 0; i--)
+    {
+        if (entries[i].name_pos == folder.length() + 1 && !strncmp(get_path(i), folder.c_str(), folder.length()))
+            remove(i);
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void FileIndex::scan_folder(const String &folder)
+{
+    Dir dir = LittleFS.openDir(folder);
+
+    add(folder + '/', 0, FILE_INDEX_DIR);
+    while (dir.next())
+    {
+        String path = folder + '/' + dir.fileName();
+        if (dir.isDirectory() || FV1::is_image_path(path))
+            continue;
+        add(path, dir.fileSize(), file_flags(path, LittleFS.exists(FV1::image_path(path))));
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+static uint8_t file_flags(const String &path, bool valid)
+{
+    String ext = path.substring(path.length() - 4);
+    ext.toLowerCase();
+    if (ext != ".hex")
+        return 0;
+    return FILE_INDEX_HEX | (valid ? FILE_INDEX_VALID : 0);
+}
+// -----------------------------------------------------------------------------------------------------
+static int cmp_part(const char *a, size_t alen, const char *b, size_t blen)
+{
+    // case-insensitive, names differing only in case ordered by strncmp
+    int res = strncasecmp(a, b, alen < blen ? alen : blen);
+    if (res)
+        return res;
+    if (alen != blen)
+        return alen < blen ? -1 : 1;
+    return strncmp(a, b, alen);
+}
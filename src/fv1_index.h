@@ -0,0 +1,76 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_INDEX_H
+#define _FV1_INDEX_H
+
+// In-RAM index of the file library (root files and one folder level).
+// Built once at boot, then every change made through the web or FTP server
+// re-reads only the path it touched. Entries are kept sorted by folder and
+// name (case-insensitive), paths are packed into a single pool of C strings.
+// Decoded bank images (.fv1img) are not indexed.
+
+#include <Arduino.h>
+#include <vector>
+
+#define FILE_INDEX_DIR      (0x01u)     // folder entry "folder/"
+#define FILE_INDEX_HEX      (0x02u)     // .hex extension, an FV-1 bank
+#define FILE_INDEX_VALID    (0x04u)     // decoded without errors (upload check or a decoded image)
+
+typedef struct
+{
+    uint16_t path;          // offset in the path pool: "name" or "folder/name"
+    uint8_t name_pos;       // name offset in the path, 0 = root file
+    uint8_t flags;
+    uint32_t size;
+}file_index_entry_t;
+
+class FileIndex
+{
+public:
+    void begin(void);
+    void update(const String &path, bool valid = false);
+    int16_t find(const String &path);
+    int16_t step(const String &path, int8_t dir);
+    bool match(uint16_t i, const String &pattern);
+    uint16_t get_count(void) {return entries.size();}
+    const file_index_entry_t &get_entry(uint16_t i) {return entries[i];}
+    const char *get_path(uint16_t i) {return &pool[entries[i].path];}
+    const char *get_name(uint16_t i) {return &pool[entries[i].path + entries[i].name_pos];}
+    String get_folder(uint16_t i);
+    bool same_folder(uint16_t a, uint16_t b);
+    uint32_t get_generation(void) {return generation;}
+    uint32_t get_used_bytes(void) {return used_bytes;}
+    uint32_t get_total_bytes(void) {return total_bytes;}
+private:
+    std::vector<file_index_entry_t> entries;
+    std::vector<char> pool;
+    uint32_t generation = 0;
+    uint32_t used_bytes = 0;    // file system usage at the last change
+    uint32_t total_bytes = 0;
+    void changed(void);
+    int cmp(const char *path, uint8_t name_pos, uint16_t i);
+    uint16_t lower_bound(const char *path, uint8_t name_pos);
+    void add(const String &path, uint32_t size, uint8_t flags);
+    void remove(uint16_t i);
+    void remove_folder(const String &folder);
+    void scan_folder(const String &folder);
+};
+
+extern FileIndex file_index;
+
+#endif // _FV1_INDEX_H
@@ -0,0 +1,111 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fv1_list.h"
+#include <LittleFS.h>
+
+list_rec_t FileList::least[LIST_BATCH];
+
+// -----------------------------------------------------------------------------------------------------
+FileList::FileList(bool ascending)
+{
+    this->ascending = ascending;
+    batch = (list_rec_t *)malloc(LIST_BATCH_MAX * sizeof(list_rec_t));
+    size = LIST_BATCH_MAX;
+    if (!batch)
+    {
+        batch = least;
+        size = LIST_BATCH;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+FileList::~FileList()
+{
+    if (batch != least)
+        free(batch);
+}
+// -----------------------------------------------------------------------------------------------------
+uint16_t FileList::next(void)
+{
+    // the next records after the last batch, less than get_size() at the end
+    Dir dir = LittleFS.openDir("/");
+    list_rec_t rec;
+    uint16_t count = 0;
+
+    passes++;
+    while (dir.next())
+    {
+        if (dir.isDirectory())
+        {
+            bool empty = true;
+            strlcpy(rec.folder, dir.fileName().c_str(), LIST_NAME_LEN);
+            Dir fold = LittleFS.openDir(dir.fileName());
+            while (fold.next())
+            {
+                empty = false;
+                strlcpy(rec.name, fold.fileName().c_str(), LIST_NAME_LEN);
+                rec.size = fold.fileSize();
+                insert(rec, count);
+            }
+            if (empty)
+            {
+                rec.name[0] = '\0';
+                rec.size = 0;
+                insert(rec, count);
+            }
+        }
+        else
+        {
+            rec.folder[0] = '\0';
+            strlcpy(rec.name, dir.fileName().c_str(), LIST_NAME_LEN);
+            rec.size = dir.fileSize();
+            insert(rec, count);
+        }
+    }
+    if (count)
+    {
+        last = batch[count - 1];
+        first = false;
+    }
+    return count;
+}
+// -----------------------------------------------------------------------------------------------------
+int FileList::cmp(const list_rec_t &a, const list_rec_t &b)
+{
+    // folders ascending with the root files first, names in the requested order
+    int res = strcasecmp(a.folder, b.folder);
+    if (!res)
+        res = strcmp(a.folder, b.folder);
+    if (res)
+        return res;
+    res = strcasecmp(a.name, b.name);
+    if (!res)
+        res = strcmp(a.name, b.name);
+    return ascending ? res : -res;
+}
+// -----------------------------------------------------------------------------------------------------
+void FileList::insert(const list_rec_t &rec, uint16_t &count)
+{
+    // keeps the size smallest records following the last batch sorted
+    if (!first && cmp(rec, last) <= 0)
+        return;
+    if (count == size && cmp(rec, batch[count - 1]) >= 0)
+        return;
+    uint16_t i = count < size ? count++ : count - 1;
+    for (; i && cmp(rec, batch[i - 1]) < 0; i--)
+        batch[i] = batch[i - 1];
+    batch[i] = rec;
+}
@@ -0,0 +1,62 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FV1_LIST_H
+#define _FV1_LIST_H
+
+// Listing of the whole file system (root files and one folder level) in sort order:
+// folders ascending with the root files first, names in the requested order, both
+// case-insensitive. The records come in batches of the next ones after the previous
+// batch, each batch takes one pass over the directories. Memory use is fixed, it does
+// not depend on the number of files.
+
+#include <Arduino.h>
+
+#define LIST_NAME_LEN       (33u)   // LittleFS name length limit + NUL
+#define LIST_BATCH          (16u)   // records per pass if the batch can not be allocated
+#define LIST_BATCH_MAX      (32u)   // records per pass, about 2.2 KiB of heap while listing
+
+// directory listing record, compact and fixed size
+typedef struct
+{
+    char folder[LIST_NAME_LEN];
+    char name[LIST_NAME_LEN];
+    uint32_t size;
+}list_rec_t;
+
+class FileList
+{
+public:
+    FileList(bool ascending);
+    ~FileList();
+    uint16_t next(void);
+    const list_rec_t &get_rec(uint16_t i) {return batch[i];}
+    uint16_t get_size(void) {return size;}
+    uint32_t get_passes(void) {return passes;}
+private:
+    bool ascending;
+    list_rec_t *batch;
+    uint16_t size;
+    list_rec_t last;
+    bool first = true;
+    uint32_t passes = 0;
+    static list_rec_t least[LIST_BATCH];
+    int cmp(const list_rec_t &a, const list_rec_t &b);
+    void insert(const list_rec_t &rec, uint16_t &count);
+};
+
+#endif // _FV1_LIST_H
@@ -15,37 +15,76 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "fv1_server.h"
-#include <list>
-#include <tuple>
 #include "fv1.h"
+#include "crc32.h"
+#include "fv1_events.h"
+#include "fv1_index.h"
+#include "fv1_list.h"
+
+#define ETAG_CACHE_SIZE     (8u)
+#define DEV_UPLOAD_TMP      "devload.tmp"   // /devload body, renamed over the target once it is valid
 
 const char *ssid = "FV1remote";
 const char *password = "Nadszyszkownik";
 
 const char *const PROGMEM BTN_NAME[]{"0", "1", "2", "3", "4", "5", "6", "7"};
-uint8_t btn_pressed;
+const char *const BURN_STATE_NAME[]{"idle", "detect", "write", "verify", "done", "error", "canceled"};
+const char *const PROD_STATE_NAME[]{"off", "waitChip", "burn", "waitRemove"};
+const char *const RESULT_NAME[]{"OK", "File not found!", "Not a valid FV-1 hex file!", "Hex file checksum error!", "Error!"};
+
+// raw body of a /devload request, decoded and stored while it is received
+typedef struct
+{
+    String path;
+    String tmp_path;
+    File file;
+    IHexDecoder decoder;
+    uint8_t *image;
+    bool hex;
+    uint32_t size;
+    uint8_t prg_mask;
+    FV1_result_t result;
+    bool busy;              // refused, burn or production run in progress
+    uint32_t start_us;
+    uint32_t receive_us;
+    uint32_t store_us;
+}dev_upload_t;
+
+dev_upload_t dev_upload;
 
 String fw_enabled = "";
 String fw_enabled_last = "";
 
-bool refresh_request = false;
+bool upload_rejected = false;
 
 const char WARNING[] PROGMEM = R"(<h2>No File System found!</h2>)";
 const char HELPER[] PROGMEM = R"(<h2>Please upload index.html to the /htm folder</h2>)";
 
 ESP8266WebServer server(80);
 FTPServer ftpSrv(LittleFS);
+FileIndex file_index;
 
 void enable_file(void);
 void sendResponse();
 void burn_eeprom();
 void enable_eeprom(void);
-bool handleList(bool bypasshtm);
+bool handleList(void);
+bool list_index(void);
+String list_summary(uint32_t used_bytes, uint32_t total_bytes);
 void deleteRecursive(const String &path);
 bool handleFile(String &&path);
 void handleUpload();
+void sendUploadResponse();
+void dev_receive(void);
+void dev_load(void);
+bool dev_busy(void);
 void formatFS();
 const String formatBytes(size_t const &bytes);
+String prg_status(void);
+String burn_status(void);
+void eep_dump(void);
+void files_changed(const String &path, bool valid = false);
+String file_etag(File &f);
 
 // -----------------------------------------------------------------------------------------------------
 void server_init(void)
@@ -72,8 +111,10 @@ void server_init(void)
     }
     Serial.println("mDNS responder started");
     server.on("/format", formatFS);
-    server.on("/upload", HTTP_POST, sendResponse, handleUpload);
-    server.on("/uploadhex", HTTP_POST, sendResponse, handleUpload);
+    server.on("/upload", HTTP_POST, sendUploadResponse, handleUpload);
+    server.on("/uploadhex", HTTP_POST, sendUploadResponse, handleUpload);
+    // dev loop: upload + enable + optional program select in one request (watcher.py)
+    server.on("/devload", HTTP_POST, dev_load, dev_receive);
     server.onNotFound([]() {
         if (!handleFile(server.urlDecode(server.uri())))
             server.send(404, "text/plain", "FileNotFound");
@@ -92,27 +133,81 @@ void server_init(void)
         temp += "]";
         server.send(200, "application/json", temp);
     });
+    // program switch is only queued here and executed from loop(), the result is pushed as program
+    // event and can be read on /prgstatus
     server.on("/press", HTTP_POST, []() {
-        bool result = false;
         if (server.args())
+            fv1.request_prg(server.argName(0).toInt());
+        server.send(200, "application/json", prg_status());
+    });
+    server.on("/prgstatus", HTTP_GET, []() {
+        server.send(200, "application/json", prg_status());
+    });
+    // program of any file, without enabling it, queued like /press
+    server.on("/program", HTTP_GET, []() {
+        if (server.hasArg("file") && server.hasArg("prg"))
+            fv1.request_prg(server.arg("file"), server.arg("prg").toInt());
+        server.send(200, "application/json", prg_status());
+    });
+    // burn the EEPROM using currently loaded/parsed hex file
+    server.on("/burn", burn_eeprom);
+    server.on("/burn/status", HTTP_GET, []() {
+        server.send(200, "application/json", burn_status());
+    });
+    server.on("/burn/cancel", HTTP_GET, []() {
+        fv1.burn_cancel();
+        server.send(200, "application/json", burn_status());
+    });
+    // EEPROM read back
+    server.on("/eepdump", HTTP_GET, eep_dump);
+    // CRC32 of each program slot in the EEPROM compared with the enabled file
+    server.on("/eepcrc", HTTP_GET, []() {
+        uint32_t crc[FV1_PRG_COUNT];
+        if (!fv1.eep_prg_crc(FV1_EEP_ADDR, crc))
         {
-            btn_pressed = server.argName(0).toInt();
-            result = fv1.set_prg(btn_pressed);
+            server.send(503, "text/plain", "No EEPROM detected!");
+            return;
         }
-        // Http reply
-        String temp = "\"";
-        for (byte i = 0; i < 8; i++)
+        char buf[9];
+        String differ = "";
+        String temp = "{\"slots\":[";
+        for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
         {
-            if (i == btn_pressed && result)
-                temp += 1;
-            else
-                temp += 0;
+            bool same = fv1.get_fw_loaded() && crc[i] == fv1.get_prg_crc(i);
+            if (i)
+                temp += ',';
+            snprintf(buf, sizeof(buf), "%08x", crc[i]);
+            temp += (String) "{\"eeprom\":\"" + buf + "\"";
+            snprintf(buf, sizeof(buf), "%08x", fv1.get_prg_crc(i));
+            temp += (String) ",\"file\":\"" + buf + "\"";
+            temp += (String) ",\"match\":" + (same ? "true" : "false") + "}";
+            if (!same)
+                differ += (String) (differ.length() ? "," : "") + i;
         }
-        temp += "\"";
+        temp += "],\"differ\":[" + differ + "]}";
+        server.send(200, "application/json", temp);
+    });
+    // production mode, run=1 starts, run=0 stops it, always returns the throughput statistics
+    server.on("/production", HTTP_GET, []() {
+        bool result = true;
+        if (server.arg("run") == "1")
+            result = fv1.prod_start();
+        else if (server.arg("run") == "0")
+            fv1.prod_stop();
+        const fv1_prod_stats_t &st = fv1.get_prod_stats();
+        uint32_t run_ms = st.state != FV1_PROD_OFF ? millis() - st.start_ms : 0;
+        String temp = "{";
+        temp += (String) "\"result\":\"" + (result ? "OK" : "ERROR!") + "\"";
+        temp += (String) ",\"state\":\"" + PROD_STATE_NAME[st.state] + "\"";
+        temp += (String) ",\"lastPass\":" + (st.last_pass ? "true" : "false");
+        temp += (String) ",\"chips\":" + st.chips;
+        temp += (String) ",\"failed\":" + st.failed;
+        temp += (String) ",\"failureRate\":" + String(st.chips ? 100.0f * st.failed / st.chips : 0.0f, 1);
+        temp += (String) ",\"meanBurnMs\":" + (st.chips ? st.burn_ms_total / st.chips : 0);
+        temp += (String) ",\"chipsPerHour\":" + String(run_ms ? 3600000.0f * st.chips / run_ms : 0.0f, 1);
+        temp += "}";
         server.send(200, "application/json", temp);
     });
-    // burn the EEPROM using currently loaded/parsed hex file
-    server.on("/burn", burn_eeprom);
 
     server.on("/eepen", enable_eeprom);
     // show the ip address
@@ -122,21 +217,93 @@ void server_init(void)
         temp += "]";
         server.send(200, "application/json", temp);
     });
-    // used to reload the site
-    server.on("/refresh", HTTP_GET, []() {
-        String reply = refresh_request ? "1" : "0";
-        String temp = "[";
-        temp +=  refresh_request ;
-        temp += "]";
+    // push channel for the web page
+    server.on("/events", HTTP_GET, events_subscribe);
+
+    // decoded image cache statistics
+    server.on("/cachestats", HTTP_GET, []() {
+        if (server.hasArg("budget"))
+            fv1.get_cache().set_budget(server.arg("budget").toInt());
+        String temp = "{";
+        temp += (String) "\"hits\":" + fv1.get_image_hits();
+        temp += (String) ",\"misses\":" + fv1.get_image_misses();
+        temp += (String) ",\"ram\":{\"entries\":" + fv1.get_cache().get_entries();
+        temp += (String) ",\"budget\":" + fv1.get_cache().get_budget();
+        temp += (String) ",\"hits\":" + fv1.get_cache().get_hits();
+        temp += (String) ",\"misses\":" + fv1.get_cache().get_misses();
+        temp += (String) ",\"evictions\":" + fv1.get_cache().get_evictions();
+        temp += (String) ",\"freeHeap\":" + ESP.getFreeHeap() + "}";
+        temp += "}";
+        server.send(200, "application/json", temp);
+    });
+
+    // program transfer timing, any of pulse, pulsemax, start, idle (us) changes it
+    server.on("/timing", HTTP_GET, []() {
+        const fv1_timing_t &t = fv1.get_timing();
+        if (server.hasArg("pulse") || server.hasArg("pulsemax") || server.hasArg("start") || server.hasArg("idle"))
+        {
+            fv1.set_timing(server.hasArg("pulse") ? server.arg("pulse").toInt() : t.rst_pulse_min_us,
+                           server.hasArg("pulsemax") ? server.arg("pulsemax").toInt() : t.rst_pulse_max_us,
+                           server.hasArg("start") ? server.arg("start").toInt() : t.start_us,
+                           server.hasArg("idle") ? server.arg("idle").toInt() : t.idle_us);
+        }
+        String temp = "{";
+        temp += (String) "\"pulseUs\":" + t.rst_pulse_us;
+        temp += (String) ",\"pulseMinUs\":" + t.rst_pulse_min_us;
+        temp += (String) ",\"pulseMaxUs\":" + t.rst_pulse_max_us;
+        temp += (String) ",\"startUs\":" + t.start_us;
+        temp += (String) ",\"idleUs\":" + t.idle_us;
+        temp += (String) ",\"retries\":" + t.retries;
+        temp += "}";
+        server.send(200, "application/json", temp);
+    });
+    // program transfer statistics
+    server.on("/stats", HTTP_GET, []() {
+        const fv1_edge_stats_t &st = fv1.get_edge_stats();
+        uint32_t mhz = ESP.getCpuFreqMHz();
+        String temp = "{";
+#ifdef FV1_EDGE_STATS
+        temp += "\"edgeStats\":true";
+#else
+        temp += "\"edgeStats\":false";
+#endif
+        temp += (String) ",\"cpuMHz\":" + mhz;
+        temp += (String) ",\"transfers\":" + st.transfers;
+        temp += (String) ",\"timeouts\":" + st.timeouts;
+        temp += (String) ",\"lastTransferUs\":" + st.last_cycles / mhz;
+        temp += (String) ",\"maxTransferUs\":" + st.max_cycles / mhz;
+        temp += (String) ",\"hdrIters\":" + st.hdr_iters;
+        temp += (String) ",\"dataIters\":" + st.data_iters;
+        temp += (String) ",\"cyclesPerPoll\":" + (st.hdr_iters + st.data_iters ? st.last_cycles / (st.hdr_iters + st.data_iters) : 0);
+        temp += (String) ",\"edgeMaxCycles\":" + st.edge_max;
+        temp += (String) ",\"edgeBucketCycles\":" + (1 << FV1_EDGE_STATS_SHIFT);
+        temp += ",\"edgeHist\":[";
+        for (uint8_t i = 0; i < FV1_EDGE_STATS_BUCKETS; i++)
+        {
+            if (i)
+                temp += ',';
+            temp += st.edge_hist[i];
+        }
+        temp += "]}";
         server.send(200, "application/json", temp);
-        refresh_request = false;
     });
 
+    // tell all open pages to reload the enabled file and the file list (watcher.py)
     server.on("/trigrefresh", HTTP_GET, []() {
-        refresh_request = true;
+        events_send("refresh", "1");
         sendResponse();
     });
 
+    // needed by handleFile for the compressed files and the cache validation
+    const char *headers[] = {"Accept-Encoding", "If-None-Match"};
+    server.collectHeaders(headers, 2);
+    file_index.begin();
+    ftpSrv.onChange([](const String &path) {
+        // STOR, DELE, both names of RNFR/RNTO: the image next to the file may be stale
+        if (!FV1::is_image_path(path))
+            LittleFS.remove(FV1::image_path(path));
+        files_changed(path);
+    });
     server.begin();
     ftpSrv.begin("fv1", "fv1");
     if (!MDNS.begin("fv1"))
@@ -147,15 +314,42 @@ void server_init(void)
 // -----------------------------------------------------------------------------------------------------
 void server_process(void)
 {
+    static uint32_t prg_seq = 0;
+    static fv1_burn_state_t burn_state = FV1_BURN_IDLE;
+    static uint32_t burn_ms = 0;
+
     server.handleClient();
     ftpSrv.handleFTP(); 
     MDNS.update();
+    // push the state changes made by loop() to the open pages
+    if (fv1.get_prg_request().done_seq != prg_seq)
+    {
+        prg_seq = fv1.get_prg_request().done_seq;
+        events_send("program", prg_status());
+    }
+    if (fv1.get_burn_stats().state != burn_state || (fv1.burn_busy() && millis() - burn_ms >= 250))
+    {
+        burn_state = fv1.get_burn_stats().state;
+        burn_ms = millis();
+        events_send("burn", burn_status());
+    }
+    events_process();
+    fv1.get_cache().trim();     // release cached banks if the servers need the heap
 }
 // -----------------------------------------------------------------------------------------------------
 void enable_file(void)
 {
     String server_reply = "";
 
+    // the burn writes the enabled bank to the EEPROM, it is not replaced meanwhile
+    if (fv1.burn_busy())
+    {
+        if (server.hasArg("file") || server.hasArg("step"))
+            server.send(409, "application/json", "[\"EEPROM burn in progress!\"]");
+        else
+            server.send(200, "application/json", "[\"" + fw_enabled_last + "\"]");
+        return;
+    }
     if (server.hasArg("file"))
     {
         fw_enabled = server.arg("file");
@@ -163,6 +357,13 @@ void enable_file(void)
         server.send(303, "message/http");
         return;
     }
+    if (server.hasArg("step"))
+    {
+        // step=1|-1 loads the next or previous bank of the library
+        int16_t i = file_index.step(fw_enabled, server.arg("step").toInt() < 0 ? -1 : 1);
+        if (i >= 0)
+            fw_enabled = String(file_index.get_entry(i).name_pos ? "" : "/") + file_index.get_path(i);
+    }
     Serial.print(F("Loading file: "));
     Serial.println(fw_enabled);
     FV1_result_t reply = fv1.load_file(fw_enabled);
@@ -188,20 +389,125 @@ void enable_file(void)
     temp += (String) "\"" + server_reply + "\"";
     temp += "]";
     server.send(200, "application/json", temp);
+    events_send("bank", temp);
 }
 // -----------------------------------------------------------------------------------------------------
 void burn_eeprom(void)
 {
-    String server_reply = "";
-
-    bool eep_result = fv1.write_eep(0x51);
+    // the burn runs from loop(), progress is reported by /burn/status
+    // optional: khz=100|400 I2C clock, mode=page|chunk write strategy, force=1 write all pages
+    uint32_t i2c_hz = server.hasArg("khz") ? server.arg("khz").toInt() * 1000 : FV1_EEP_I2C_HZ;
+    bool page_write = server.arg("mode") != "chunk";
+    bool force = server.arg("force") == "1";
+    bool started = fv1.burn_start(FV1_EEP_ADDR, i2c_hz, page_write, force);
 
     String temp = "[";
-    temp += (String) "\"" + "EEPROM burn: " + (eep_result ? "OK" : "ERROR!") + "\"";
+    temp += (String) "\"" + "EEPROM burn: " + (started ? "started" : "ERROR!") + "\"";
     temp += "]";
     server.send(200, "application/json", temp);
 }
 // -----------------------------------------------------------------------------------------------------
+// Read back the whole EEPROM as SpinASM style Intel HEX (default) or raw binary with format=bin.
+// save=<path> also stores it as a new hex bank. The CRC32 of the contents is sent in the X-CRC32 header.
+void eep_dump(void)
+{
+    bool hex = server.arg("format") != "bin";
+    String path = server.arg("save");
+    uint8_t *image = (uint8_t *)malloc(FV1_IMAGE_SIZE);
+    if (!image)
+    {
+        server.send(500, "text/plain", "Out of memory!");
+        return;
+    }
+    if (!fv1.eep_open(FV1_EEP_ADDR))
+    {
+        free(image);
+        server.send(503, "text/plain", "No EEPROM detected!");
+        return;
+    }
+    fv1.eep_read(0, image, FV1_IMAGE_SIZE);
+    fv1.eep_close();
+
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08x", crc32_calc(image, FV1_IMAGE_SIZE));
+    File file;
+    if (path.length())
+    {
+        if (!path.startsWith("/"))
+            path = "/" + path;
+        if (!path.endsWith(".hex"))
+            path += ".hex";
+        LittleFS.remove(FV1::image_path(path));
+        file = LittleFS.open(path, "w");
+    }
+    server.sendHeader("X-CRC32", crc);
+    server.sendHeader("Content-Disposition", hex ? "attachment; filename=\"eeprom.hex\"" : "attachment; filename=\"eeprom.bin\"");
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, hex ? "text/plain" : "application/octet-stream", "");
+    if (!hex)
+        server.sendContent((const char *)image, FV1_IMAGE_SIZE);
+    if (hex || file)
+    {
+        // hex text is generated per block, the full file is never held in RAM
+        const uint8_t rec_len = 4;     // one instruction per record, like SpinASM
+        const uint16_t block = 128;
+        char buf[(block / rec_len) * IHEX_RECORD_CHARS(rec_len) + 1];
+        for (uint16_t addr = 0; addr <= FV1_IMAGE_SIZE; addr += block)
+        {
+            size_t len = 0;
+            if (addr == FV1_IMAGE_SIZE)
+                len = ihex_format_record(buf, 0x01, 0, NULL, 0);   // end of file record
+            for (uint16_t rec = addr; rec < addr + block && rec < FV1_IMAGE_SIZE; rec += rec_len)
+                len += ihex_format_record(&buf[len], 0x00, rec, &image[rec], rec_len);
+            if (hex)
+                server.sendContent(buf, len);
+            if (file)
+                file.write((const uint8_t *)buf, len);
+        }
+    }
+    server.sendContent("");
+    free(image);
+    if (file)
+    {
+        file.close();
+        files_changed(path);
+    }
+    Serial.printf(PSTR("EEPROM dump, CRC32 %s\n"), crc);
+}
+// -----------------------------------------------------------------------------------------------------
+String burn_status(void)
+{
+    const fv1_burn_stats_t &st = fv1.get_burn_stats();
+    uint32_t elapsed = fv1.burn_busy() ? millis() - st.start_ms : st.burn_ms;
+    String temp = "{";
+    temp += (String) "\"state\":\"" + BURN_STATE_NAME[st.state] + "\"";
+    temp += (String) ",\"mode\":\"" + (st.page_write ? "page" : "chunk") + "\"";
+    temp += (String) ",\"i2cKHz\":" + st.i2c_hz / 1000;
+    temp += (String) ",\"bytesWritten\":" + st.bytes_written;
+    temp += (String) ",\"bytesVerified\":" + st.bytes_verified;
+    temp += (String) ",\"bytesTotal\":" + FV1_IMAGE_SIZE;
+    temp += (String) ",\"pagesWritten\":" + st.pages_written;
+    temp += (String) ",\"pagesSkipped\":" + st.pages_skipped;
+    temp += (String) ",\"elapsedMs\":" + elapsed;
+    temp += (String) ",\"retries\":" + st.retries;
+    temp += (String) ",\"failedPage\":" + st.failed_page;
+    // [page, writes repeated] of every page that failed its read back at least once
+    temp += ",\"pageErrors\":[";
+    bool first = true;
+    for (uint16_t page = 0; page < FV1_EEP_PAGES; page++)
+    {
+        uint8_t retries = fv1.get_burn_retries(page);
+        if (!retries)
+            continue;
+        if (!first)
+            temp += ',';
+        temp += (String) "[" + page + "," + retries + "]";
+        first = false;
+    }
+    temp += "]}";
+    return temp;
+}
+// -----------------------------------------------------------------------------------------------------
 void enable_eeprom(void)
 {
     uint8_t eep_result = fv1.toggle_slave_i2c();
@@ -214,96 +520,112 @@ void enable_eeprom(void)
     server.send(200, "application/json", temp);
 }
 // -----------------------------------------------------------------------------------------------------
-bool handleList(bool bypasshtm)
+bool handleList(void)
 {
+    // one batch of the next records in sort order per pass over the directories
+    FileList list(server.arg(0) == "1");
+    bool first = true;
+    uint16_t count;
     FSInfo fs_info;
-    LittleFS.info(fs_info);
-    Dir dir = LittleFS.openDir("/");
-    using namespace std;
-    using records = tuple<String, String, int>;
-    list<records> dirList;
+    String temp;
 
-    while (dir.next())
+    LittleFS.info(fs_info);
+    temp.reserve(LIST_BATCH * (2 * LIST_NAME_LEN + 48));
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+    do
     {
-        if (dir.isDirectory())
+        count = list.next();
+        temp = first ? "[" : "";
+        for (uint16_t i = 0; i < count; i++)
         {
-            if (dir.fileName() != String("htm") || !bypasshtm)
+            const list_rec_t &rec = list.get_rec(i);
+            if (!first || i)
+                temp += ',';
+            temp += (String) "{\"folder\":\"" + rec.folder + "\",\"name\":\"" + rec.name + "\",\"size\":\"" + formatBytes(rec.size) + "\"}";
+            if ((i + 1) % LIST_BATCH == 0)
             {
-                uint8_t ran{0};
-                Dir fold = LittleFS.openDir(dir.fileName());
-                while (fold.next())
-                {
-                    ran++;
-                    dirList.emplace_back(dir.fileName(), fold.fileName(), fold.fileSize());
-                }
-                if (!ran)
-                {
-                    dirList.emplace_back(dir.fileName(), "", 0);
-                }
+                server.sendContent(temp);
+                temp = "";
             }
         }
-        else
-        {
-            dirList.emplace_back("", dir.fileName(), dir.fileSize());
-        }
-    }
-    dirList.sort([](const records &f, const records &l) {
-        if (server.arg(0) == "1")
+        if (count)
+            first = false;
+        if (count < list.get_size())
+            temp += (String) (first ? "" : ",") + list_summary(fs_info.usedBytes, fs_info.totalBytes) + "]";
+        if (temp.length())      // an empty chunk ends the response
+            server.sendContent(temp);
+        yield();
+    } while (count == list.get_size());
+    server.sendContent("");
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+bool list_index(void)
+{
+    // the hex library view is answered from the file index, optional find=text filters the names
+    bool ascending = server.arg(0) == "1";
+    String pattern = server.arg("find");
+    uint16_t count = file_index.get_count();
+    uint8_t batch = 0;
+    bool first = true;
+    String temp = "[";
+
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "application/json", "");
+    for (uint16_t start = 0, end; start < count; start = end)
+    {
+        // one folder at a time, folders ascending, names in the requested order
+        for (end = start + 1; end < count && file_index.same_folder(start, end); end++);
+        String folder = file_index.get_folder(start);
+        if (folder == "htm")
+            continue;
+        for (uint16_t n = 0; n < end - start; n++)
         {
-            for (uint8_t i = 0; i < 31; i++)
+            uint16_t i = ascending ? start + n : end - 1 - n;
+            const file_index_entry_t &e = file_index.get_entry(i);
+            if (e.flags & FILE_INDEX_DIR)
             {
-                if (tolower(get<1>(f)[i]) < tolower(get<1>(l)[i]))
-                    return true;
-                else if (tolower(get<1>(f)[i]) > tolower(get<1>(l)[i]))
-                    return false;
+                if (end - start > 1 || pattern.length()) // listed only if empty
+                    continue;
             }
-            return false;
-        }
-        else
-        {
-            for (uint8_t i = 0; i < 31; i++)
+            else if (!file_index.match(i, pattern))
             {
-                if (tolower(get<1>(f)[i]) > tolower(get<1>(l)[i]))
-                    return true;
-                else if (tolower(get<1>(f)[i]) < tolower(get<1>(l)[i]))
-                    return false;
+                continue;
             }
-            return false;
-        }
-    });
-    dirList.sort([](const records &f, const records &l) {
-        if (get<0>(f)[0] != 0x00 || get<0>(l)[0] != 0x00)
-        {
-            for (uint8_t i = 0; i < 31; i++)
+            if (!first)
+                temp += ',';
+            temp += (String) "{\"folder\":\"" + folder + "\",\"name\":\"" + file_index.get_name(i) + "\",\"size\":\"" + formatBytes(e.size) + "\"}";
+            first = false;
+            if (++batch == LIST_BATCH)
             {
-                if (tolower(get<0>(f)[i]) < tolower(get<0>(l)[i]))
-                    return true;
-                else if (tolower(get<0>(f)[i]) > tolower(get<0>(l)[i]))
-                    return false;
+                server.sendContent(temp);
+                temp = "";
+                batch = 0;
             }
         }
-        return false;
-    });
-    String temp = "[";
-    for (auto &t : dirList)
-    {
-        if (temp != "[")
-            temp += ',';
-        temp += "{\"folder\":\"" + get<0>(t) + "\",\"name\":\"" + get<1>(t) + "\",\"size\":\"" + formatBytes(get<2>(t)) + "\"}";
     }
-    temp += ",{\"usedBytes\":\"" + formatBytes(fs_info.usedBytes) +
-            "\",\"totalBytes\":\"" + formatBytes(fs_info.totalBytes) +
-            "\",\"freeBytes\":\"" + (fs_info.totalBytes - fs_info.usedBytes) + "\"}]";
-    server.send(200, "application/json", temp);
+    temp += (String) (first ? "" : ",") + list_summary(file_index.get_used_bytes(), file_index.get_total_bytes()) + "]";
+    server.sendContent(temp);
+    server.sendContent("");
     return true;
 }
 // -----------------------------------------------------------------------------------------------------
+String list_summary(uint32_t used_bytes, uint32_t total_bytes)
+{
+    return (String) "{\"usedBytes\":\"" + formatBytes(used_bytes) +
+           "\",\"totalBytes\":\"" + formatBytes(total_bytes) +
+           "\",\"freeBytes\":\"" + (total_bytes - used_bytes) +
+           "\",\"generation\":" + file_index.get_generation() + "}";
+}
+// -----------------------------------------------------------------------------------------------------
 void deleteRecursive(const String &path)
 {
     Serial.print("deleting: ");
     Serial.println(path);
     if (LittleFS.remove(path))
     {
+        LittleFS.remove(FV1::image_path(path));
         LittleFS.open(path.substring(0, path.lastIndexOf('/')) + "/", "w");
         return;
     }
@@ -325,14 +647,16 @@ bool handleFile(String &&path)
                 if (e == c)
                     e = 95;
         LittleFS.mkdir(folderName);
+        files_changed(folderName);
     }
     if (server.hasArg("sort"))
-        return handleList(false);
+        return handleList();
     if (server.hasArg("sortHex"))
-        return handleList(true);
+        return list_index();
     if (server.hasArg("delete"))
     {
         deleteRecursive(server.arg("delete"));
+        files_changed(server.arg("delete"));
         sendResponse();
         return true;
     }
@@ -341,12 +665,75 @@ bool handleFile(String &&path)
     if (path.endsWith("/"))
         path += "htm/index.html";
 
-    return (LittleFS.exists(path) ? ({File f = LittleFS.open(path, "r"); server.streamFile(f, mime::getContentType(path)); f.close(); true; }) : false);
+    if (!LittleFS.exists(path))
+        return false;
+    // pre-compressed variant made by the build (scripts/compress_htm.py)
+    String file_path = path;
+    if (server.header("Accept-Encoding").indexOf("gzip") >= 0 && LittleFS.exists(path + ".gz"))
+        file_path += ".gz";
+    File f = LittleFS.open(file_path, "r");
+    String etag = file_etag(f);
+    server.sendHeader("ETag", etag);
+    server.sendHeader("Vary", "Accept-Encoding");
+    // The compressed page links its assets with the ETag of the build (scripts/compress_htm.py),
+    // the content of such a URL never changes. Everything else is revalidated with the ETag.
+    if (path.startsWith("/htm/") && !path.endsWith(".html") && etag == "\"" + server.arg("v") + "\"")
+        server.sendHeader("Cache-Control", "max-age=31536000, immutable");
+    else
+        server.sendHeader("Cache-Control", "no-cache");
+    if (server.header("If-None-Match") == etag)
+        server.send(304);
+    else
+        server.streamFile(f, mime::getContentType(path));   // adds Content-Encoding for .gz
+    f.close();
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+String file_etag(File &f)
+{
+    // CRC32 of the content, cached while size and last write time stay the same
+    static struct
+    {
+        String name;
+        uint32_t size;
+        time_t mtime;
+        uint32_t crc;
+    }etags[ETAG_CACHE_SIZE];
+    static uint8_t next = 0;
+    String name = f.fullName();
+    uint32_t size = f.size();
+    time_t mtime = f.getLastWrite();
+    char buf[11];
+
+    uint8_t i = 0;
+    while (i < ETAG_CACHE_SIZE && !(etags[i].name == name && etags[i].size == size && etags[i].mtime == mtime))
+        i++;
+    if (i == ETAG_CACHE_SIZE)
+    {
+        uint8_t data[256];
+        uint32_t crc = CRC32_INIT;
+        size_t len;
+        while ((len = f.read(data, sizeof(data))) > 0)
+            crc = crc32_update(crc, data, len);
+        f.seek(0);
+        i = next;
+        next = (next + 1) % ETAG_CACHE_SIZE;
+        etags[i].name = name;
+        etags[i].size = size;
+        etags[i].mtime = mtime;
+        etags[i].crc = crc32_final(crc);
+    }
+    snprintf(buf, sizeof(buf), "\"%08x\"", etags[i].crc);
+    return buf;
 }
 // -----------------------------------------------------------------------------------------------------
 void handleUpload()
 {
     static File fsUploadFile;
+    static String uploadPath;
+    static IHexDecoder hexDecoder;
+    static uint8_t *hexImage = NULL;    // hex files are decoded on the fly
+    static FV1_result_t hexResult;
     HTTPUpload &upload = server.upload();
     if (upload.status == UPLOAD_FILE_START)
     {
@@ -355,32 +742,307 @@ void handleUpload()
             upload.filename = upload.filename.substring(upload.filename.length() - 31, upload.filename.length());
         }
         printf(PSTR("handleFileUpload Name: /%s\n"), upload.filename.c_str());
-        fsUploadFile = LittleFS.open(server.arg(0) + "/" + server.urlDecode(upload.filename), "w");
+        uploadPath = server.arg(0) + "/" + server.urlDecode(upload.filename);
+        fsUploadFile = LittleFS.open(uploadPath, "w");
+        hexResult = FV1_OK;
+        free(hexImage);
+        hexImage = NULL;
+        String ext = uploadPath.substring(uploadPath.length() - 4);
+        ext.toLowerCase();
+        if (ext == ".hex")
+        {
+            LittleFS.remove(FV1::image_path(uploadPath)); // drop the image of the previous version
+            hexImage = (uint8_t *)malloc(FV1_IMAGE_SIZE);
+            if (hexImage)
+            {
+                memset(hexImage, 0, FV1_IMAGE_SIZE);
+                hexDecoder.begin(hexImage, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+            }
+        }
     }
     else if (upload.status == UPLOAD_FILE_WRITE)
     {
+        if (hexResult != FV1_OK) // rejected, drop the rest of the file
+            return;
         printf(PSTR("handleFileUpload Data: %u\n"), upload.currentSize);
-        fsUploadFile.write(upload.buf, upload.currentSize);
+        if (hexImage && hexDecoder.feed(upload.buf, upload.currentSize) > IHEX_DONE)
+            hexResult = FV1::decode_result(hexDecoder.get_result(), hexDecoder.get_block_mask());
+        else
+            fsUploadFile.write(upload.buf, upload.currentSize);
     }
     else if (upload.status == UPLOAD_FILE_END)
     {
+        if (hexResult != FV1_OK) // already rejected
+            return;
         printf(PSTR("handleFileUpload Size: %u\n"), upload.totalSize);
         fsUploadFile.close();
+        if (hexImage)
+        {
+            hexResult = FV1::decode_result(hexDecoder.finish(), hexDecoder.get_block_mask());
+            if (hexResult == FV1_OK)
+                FV1::save_image(uploadPath, hexImage, hexDecoder.get_block_mask());
+        }
+    }
+    else if (upload.status == UPLOAD_FILE_ABORTED)
+    {
+        fsUploadFile.close();
+        LittleFS.remove(uploadPath);
+    }
+    if (hexResult != FV1_OK && hexImage)
+    {
+        // corrupt hex file, do not leave a part of it in the library
+        fsUploadFile.close();
+        LittleFS.remove(uploadPath);
+        LittleFS.remove(FV1::image_path(uploadPath));
+        Serial.print(F("Upload rejected: "));
+        fv1.print_result(hexResult);
+        upload_rejected = true;
+    }
+    if (upload.status == UPLOAD_FILE_END || upload.status == UPLOAD_FILE_ABORTED || hexResult != FV1_OK)
+    {
+        files_changed(uploadPath, hexImage && hexResult == FV1_OK && upload.status == UPLOAD_FILE_END);
+        free(hexImage);
+        hexImage = NULL;
     }
 }
 // -----------------------------------------------------------------------------------------------------
 void formatFS()
 {
     LittleFS.format();
+    files_changed("/");
     sendResponse();
 }
 // -----------------------------------------------------------------------------------------------------
+void sendUploadResponse()
+{
+    if (upload_rejected)
+    {
+        upload_rejected = false;
+        server.send(400, "text/plain", "Not a valid FV-1 hex file!");
+        return;
+    }
+    sendResponse();
+}
+// -----------------------------------------------------------------------------------------------------
+void dev_receive(void)
+{
+    // Body sent as application/octet-stream, format=bin for a binary image of up to 8 programs,
+    // a hex file otherwise. The hex file is stored as it is, the binary image as hex, both get
+    // their decoded image right away. The body goes to a temporary file, the bank on flash is
+    // replaced only by a valid upload.
+    HTTPRaw &raw = server.raw();
+    if (raw.status == RAW_START)
+    {
+        dev_upload.start_us = micros();
+        dev_upload.path = server.hasArg("file") ? server.arg("file") : String("dev.hex");
+        if (!dev_upload.path.startsWith("/"))
+            dev_upload.path = "/" + dev_upload.path;
+        if (!dev_upload.path.endsWith(".hex"))
+            dev_upload.path += ".hex";
+        dev_upload.tmp_path = dev_upload.path.substring(0, dev_upload.path.lastIndexOf('/') + 1) + DEV_UPLOAD_TMP;
+        dev_upload.hex = server.arg("format") != "bin";
+        dev_upload.size = 0;
+        dev_upload.prg_mask = 0;
+        dev_upload.receive_us = 0;
+        dev_upload.store_us = 0;
+        dev_upload.busy = dev_busy();
+        free(dev_upload.image);
+        dev_upload.image = dev_upload.busy ? NULL : (uint8_t *)malloc(FV1_IMAGE_SIZE);
+        dev_upload.result = dev_upload.image ? FV1_OK : FV1_OTHER_ERR;
+        if (dev_upload.image)
+        {
+            memset(dev_upload.image, 0, FV1_IMAGE_SIZE);
+            dev_upload.decoder.begin(dev_upload.image, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+            dev_upload.file = LittleFS.open(dev_upload.tmp_path, "w");
+            if (!dev_upload.file)
+                dev_upload.result = FV1_OTHER_ERR;
+        }
+    }
+    else if (raw.status == RAW_WRITE)
+    {
+        if (dev_upload.result != FV1_OK || !raw.currentSize)
+            return;
+        if (dev_upload.hex)
+        {
+            dev_upload.file.write(raw.buf, raw.currentSize);
+            if (dev_upload.decoder.feed(raw.buf, raw.currentSize) > IHEX_DONE)
+                dev_upload.result = FV1::decode_result(dev_upload.decoder.get_result(), dev_upload.decoder.get_block_mask());
+        }
+        else if (dev_upload.size + raw.currentSize > FV1_IMAGE_SIZE)
+        {
+            dev_upload.result = FV1_INPUT_FILE_WRONG;
+        }
+        else
+        {
+            memcpy(&dev_upload.image[dev_upload.size], raw.buf, raw.currentSize);
+        }
+        dev_upload.size += raw.currentSize;
+    }
+    else if (raw.status == RAW_END)
+    {
+        if (dev_upload.result == FV1_OK)
+        {
+            if (dev_upload.hex)
+            {
+                dev_upload.prg_mask = dev_upload.decoder.get_block_mask();
+                dev_upload.result = FV1::decode_result(dev_upload.decoder.finish(), dev_upload.prg_mask);
+            }
+            else
+            {
+                // a partial image holds the first programs only
+                dev_upload.prg_mask = (1u << ((dev_upload.size + FV1_PRG_SIZE - 1) / FV1_PRG_SIZE)) - 1;
+                dev_upload.result = dev_upload.prg_mask ? FV1_OK : FV1_INPUT_FILE_WRONG;
+            }
+        }
+        if (dev_upload.result == FV1_OK && dev_busy()) // started while the body was received
+        {
+            dev_upload.busy = true;
+            dev_upload.result = FV1_OTHER_ERR;
+        }
+        dev_upload.receive_us = micros() - dev_upload.start_us;
+        uint32_t start_us = micros();
+        if (dev_upload.result == FV1_OK && !dev_upload.hex)
+        {
+            char buf[IHEX_RECORD_CHARS(4) + 1];
+            for (uint16_t addr = 0; addr < FV1_IMAGE_SIZE; addr += 4)
+            {
+                if (dev_upload.prg_mask & (1 << (addr / FV1_PRG_SIZE)))
+                    dev_upload.file.write((const uint8_t *)buf, ihex_format_record(buf, 0x00, addr, &dev_upload.image[addr], 4));
+            }
+            dev_upload.file.write((const uint8_t *)buf, ihex_format_record(buf, 0x01, 0, NULL, 0));
+        }
+        dev_upload.file.close();
+        if (dev_upload.result == FV1_OK && !LittleFS.rename(dev_upload.tmp_path, dev_upload.path))
+            dev_upload.result = FV1_OTHER_ERR;
+        if (dev_upload.result == FV1_OK)
+        {
+            FV1::save_image(dev_upload.path, dev_upload.image, dev_upload.prg_mask);
+            files_changed(dev_upload.path, true);
+        }
+        else
+        {
+            LittleFS.remove(dev_upload.tmp_path);
+        }
+        dev_upload.store_us = micros() - start_us;
+    }
+    else if (raw.status == RAW_ABORTED)
+    {
+        dev_upload.file.close();
+        LittleFS.remove(dev_upload.tmp_path);
+        dev_upload.result = FV1_OTHER_ERR;
+    }
+    if (raw.status == RAW_END || raw.status == RAW_ABORTED)
+    {
+        free(dev_upload.image);
+        dev_upload.image = NULL;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void dev_load(void)
+{
+    // POST /devload?file=name.hex&prg=N, the reply carries the time of every phase in us
+    uint32_t enable_us = 0;
+    uint32_t select_us = 0;
+    bool prg_ok = false;
+    bool busy = dev_upload.busy;
+    FV1_result_t result = dev_upload.result;
+
+    if (!dev_upload.path.length()) // no raw body, wrong content type
+    {
+        result = FV1_INPUT_FILE_NOT_FOUND;
+        busy = false;
+    }
+    if (result == FV1_OK && dev_busy())
+    {
+        result = FV1_OTHER_ERR;
+        busy = true;
+    }
+    if (result == FV1_OK)
+    {
+        uint32_t start_us = micros();
+        fw_enabled = dev_upload.path;
+        result = fv1.load_file(fw_enabled);
+        enable_us = micros() - start_us;
+        fv1.print_result(result);
+        if (result == FV1_OK)
+        {
+            fw_enabled_last = fw_enabled;
+            events_send("bank", (String) "[\"" + fw_enabled + "\"]");
+        }
+    }
+    if (result == FV1_OK && server.hasArg("prg"))
+    {
+        // executed right away, the program event is pushed by server_process as for /press
+        uint32_t start_us = micros();
+        fv1.request_prg(server.arg("prg").toInt());
+        fv1.process();
+        prg_ok = fv1.get_prg_request().done_ok;
+        select_us = micros() - start_us;
+    }
+    String temp = "{";
+    temp += (String) "\"ok\":" + (result == FV1_OK ? "true" : "false");
+    temp += (String) ",\"result\":\"" + RESULT_NAME[result] + "\"";
+    temp += (String) ",\"file\":\"" + dev_upload.path + "\"";
+    temp += (String) ",\"format\":\"" + (dev_upload.hex ? "hex" : "bin") + "\"";
+    temp += (String) ",\"bytes\":" + dev_upload.size;
+    temp += (String) ",\"prgMask\":" + dev_upload.prg_mask;
+    if (server.hasArg("prg"))
+    {
+        temp += (String) ",\"prg\":" + server.arg("prg").toInt();
+        temp += (String) ",\"prgOk\":" + (prg_ok ? "true" : "false");
+    }
+    temp += (String) ",\"timeUs\":{\"receive\":" + dev_upload.receive_us;
+    temp += (String) ",\"store\":" + dev_upload.store_us;
+    temp += (String) ",\"enable\":" + enable_us;
+    temp += (String) ",\"select\":" + select_us;
+    temp += (String) ",\"total\":" + (micros() - dev_upload.start_us) + "}}";
+    dev_upload.path = "";
+    server.send(result == FV1_OK ? 200 : busy ? 409 : 400, "application/json", temp);
+}
+// -----------------------------------------------------------------------------------------------------
+bool dev_busy(void)
+{
+    // i2c lines in use
+    return fv1.burn_busy() || fv1.get_prod_stats().state != FV1_PROD_OFF;
+}
+// -----------------------------------------------------------------------------------------------------
+void files_changed(const String &path, bool valid)
+{
+    // the compressed copy of a replaced or deleted file is stale, so are the asset
+    // fingerprints in the compressed page, the plain one links the assets without them
+    String p = path;
+    while (p.startsWith("/"))
+        p.remove(0, 1);
+    if (!path.endsWith(".gz") && LittleFS.remove(path + ".gz"))
+        file_index.update(path + ".gz");
+    if ((p == "htm" || p.startsWith("htm/")) && LittleFS.remove("/htm/index.html.gz"))
+        file_index.update("/htm/index.html.gz");
+    fv1.drop_cache(path);
+    // the pages compare the generation with the one of their last listing
+    file_index.update(path, valid);
+    events_send("files", String(file_index.get_generation()));
+}
+// -----------------------------------------------------------------------------------------------------
 void sendResponse()
 {
     server.sendHeader("Location", "/htm/index.html");
     server.send(303, "message/http");
 }
 // -----------------------------------------------------------------------------------------------------
+String prg_status(void)
+{
+    const fv1_prg_request_t &req = fv1.get_prg_request();
+    String temp = "{\"seq\":" + String(req.req_seq);
+    temp += ",\"done\":" + String(req.done_seq);
+    temp += ",\"pending\":" + String(req.pending ? "true" : "false");
+    temp += ",\"prg\":" + String(req.done_prg);
+    temp += ",\"file\":\"" + req.done_path + "\"";
+    temp += ",\"ok\":" + String(req.done_ok ? "true" : "false");
+    temp += ",\"coalesced\":" + String(req.coalesced);
+    temp += "}";
+    return temp;
+}
+// -----------------------------------------------------------------------------------------------------
 const String formatBytes(size_t const &bytes)
 {
     return (bytes < 1024 ? static_cast<String>(bytes) + " Byte" : bytes < 1048576 ? static_cast<String>(bytes / 1024.0) + 
@@ -0,0 +1,207 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ihex.h"
+#include <string.h>
+
+#define IHEX_START      ':'
+#define IHEX_NO_NIBBLE  (0xFFu)
+
+#define IHEX_TYPE_DATA          (0x00u)
+#define IHEX_TYPE_EOF           (0x01u)
+#define IHEX_TYPE_EXT_SEG_ADDR  (0x02u)
+#define IHEX_TYPE_START_SEG     (0x03u)
+#define IHEX_TYPE_EXT_LIN_ADDR  (0x04u)
+#define IHEX_TYPE_START_LIN     (0x05u)
+
+// ASCII -> nibble value, 0xFF = not a hex digit
+static const uint8_t ihex_nibble[256] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // 0-9
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // A-F
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // a-f
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+// -----------------------------------------------------------------------------------------------------
+IHexDecoder::IHexDecoder(uint8_t *image, uint32_t image_size, uint32_t block_size)
+{
+    begin(image, image_size, block_size);
+}
+// -----------------------------------------------------------------------------------------------------
+void IHexDecoder::begin(uint8_t *image, uint32_t image_size, uint32_t block_size)
+{
+    img = image;
+    img_size = image_size;
+    blk_size = block_size ? block_size : image_size;
+    reset();
+}
+// -----------------------------------------------------------------------------------------------------
+void IHexDecoder::reset(void)
+{
+    result = IHEX_BUSY;
+    record_count = 0;
+    block_mask = 0;
+    base_addr = 0;
+    in_record = false;
+    hi_nibble = IHEX_NO_NIBBLE;
+    rec_pos = 0;
+    rec_len = 0;
+    sum = 0;
+}
+// -----------------------------------------------------------------------------------------------------
+ihex_result_t IHexDecoder::feed(const uint8_t *data, size_t len)
+{
+    const uint8_t *end = data + len;
+
+    while (data < end && result == IHEX_BUSY)
+    {
+        uint8_t c = *data++;
+        if (!in_record)
+        {
+            // line endings of any OS (CRLF, LF, CR) and padding between records are skipped
+            if (c == IHEX_START)
+            {
+                in_record = true;
+                hi_nibble = IHEX_NO_NIBBLE;
+                rec_pos = 0;
+                rec_len = 5;
+                sum = 0;
+            }
+            else if (c != '\r' && c != '\n' && c != ' ' && c != '\t')
+            {
+                result = IHEX_ERR_FORMAT;
+            }
+            continue;
+        }
+        uint8_t nibble = ihex_nibble[c];
+        if (nibble == IHEX_NO_NIBBLE) // truncated record or garbage
+        {
+            result = IHEX_ERR_FORMAT;
+            break;
+        }
+        if (hi_nibble == IHEX_NO_NIBBLE)
+        {
+            hi_nibble = nibble;
+            continue;
+        }
+        uint8_t value = (hi_nibble << 4) | nibble;
+        hi_nibble = IHEX_NO_NIBBLE;
+        if (rec_pos == 0)
+            rec_len = value + 5;
+        rec[rec_pos++] = value;
+        sum += value;
+        if (rec_pos == rec_len)
+        {
+            in_record = false;
+            result = process_record();
+        }
+    }
+    return result;
+}
+// -----------------------------------------------------------------------------------------------------
+ihex_result_t IHexDecoder::finish(void)
+{
+    if (result == IHEX_BUSY) // input ended without the EOF record
+        result = IHEX_ERR_FORMAT;
+    return result;
+}
+// -----------------------------------------------------------------------------------------------------
+ihex_result_t IHexDecoder::process_record(void)
+{
+    uint8_t byte_count = rec[0];
+    uint32_t data_addr = base_addr + ((rec[1] << 8) | rec[2]);
+
+    record_count++;
+    if (sum) // checksum mismatch!
+        return IHEX_ERR_CHKSUM;
+    switch (rec[3])
+    {
+    case IHEX_TYPE_DATA:
+        if (!byte_count)
+            return IHEX_BUSY;
+        // no sum of address and count, a high extended address would wrap it into the image
+        if (data_addr >= img_size || byte_count > img_size - data_addr)
+            return IHEX_ERR_ADDRESS;
+        memcpy(&img[data_addr], &rec[4], byte_count);
+        {
+            uint32_t blk = data_addr / blk_size;
+            uint32_t blk_last = (data_addr + byte_count - 1) / blk_size;
+            for (; blk <= blk_last && blk < 32; blk++)
+                block_mask |= (1ul << blk);
+        }
+        return IHEX_BUSY;
+    case IHEX_TYPE_EOF:
+        return IHEX_DONE;
+    case IHEX_TYPE_EXT_SEG_ADDR:
+        if (byte_count != 2)
+            return IHEX_ERR_FORMAT;
+        base_addr = ((rec[4] << 8) | rec[5]) << 4;
+        return IHEX_BUSY;
+    case IHEX_TYPE_EXT_LIN_ADDR:
+        if (byte_count != 2)
+            return IHEX_ERR_FORMAT;
+        base_addr = (uint32_t)((rec[4] << 8) | rec[5]) << 16;
+        return IHEX_BUSY;
+    case IHEX_TYPE_START_SEG: // start address, meaningless for the FV-1
+    case IHEX_TYPE_START_LIN:
+        return IHEX_BUSY;
+    default:
+        return IHEX_ERR_FORMAT;
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+size_t ihex_format_record(char *dst, uint8_t type, uint16_t addr, const uint8_t *data, uint8_t len)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char *p = dst;
+    uint8_t sum = len + (addr >> 8) + (addr & 0xFF) + type;
+
+    *p++ = IHEX_START;
+    *p++ = hex[len >> 4];
+    *p++ = hex[len & 0x0F];
+    *p++ = hex[addr >> 12];
+    *p++ = hex[(addr >> 8) & 0x0F];
+    *p++ = hex[(addr >> 4) & 0x0F];
+    *p++ = hex[addr & 0x0F];
+    *p++ = hex[type >> 4];
+    *p++ = hex[type & 0x0F];
+    for (uint8_t i = 0; i < len; i++)
+    {
+        *p++ = hex[data[i] >> 4];
+        *p++ = hex[data[i] & 0x0F];
+        sum += data[i];
+    }
+    sum = -sum;
+    *p++ = hex[sum >> 4];
+    *p++ = hex[sum & 0x0F];
+    *p++ = '\r';
+    *p++ = '\n';
+    *p = '\0';
+    return p - dst;
+}
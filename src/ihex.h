@@ -0,0 +1,74 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _IHEX_H
+#define _IHEX_H
+
+// Streaming Intel HEX decoder.
+// Does not depend on the Arduino core, input can be fed in chunks of any size
+// (file reads, upload callbacks) and is decoded directly into the target image.
+// Only the bytes covered by data records are written, get_block_mask() tells
+// which blocks of the image were touched (sparse files).
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define IHEX_MAX_DATA_LEN       (255u)  // max data bytes in a single record
+#define IHEX_RECORD_CHARS(len)  (13u + 2u * (len))  // formatted record incl. CR LF
+
+typedef enum
+{
+    IHEX_BUSY,              // record(s) decoded, more input expected
+    IHEX_DONE,              // end of file record decoded
+    IHEX_ERR_FORMAT,        // not an Intel HEX stream or unsupported record
+    IHEX_ERR_CHKSUM,        // record checksum mismatch
+    IHEX_ERR_ADDRESS        // data outside of the target image
+}ihex_result_t;
+
+class IHexDecoder
+{
+public:
+    IHexDecoder(uint8_t *image = NULL, uint32_t image_size = 0, uint32_t block_size = 0);
+    void begin(uint8_t *image, uint32_t image_size, uint32_t block_size = 0);
+    void reset(void);
+    ihex_result_t feed(const uint8_t *data, size_t len);
+    ihex_result_t finish(void);
+    ihex_result_t get_result(void) {return result;}
+    uint32_t get_record_count(void) {return record_count;}
+    uint32_t get_block_mask(void) {return block_mask;}
+private:
+    uint8_t *img;
+    uint32_t img_size;
+    uint32_t blk_size;          // image is split into up to 32 blocks
+    uint32_t block_mask;        // blocks written by data records
+    uint32_t base_addr;         // set by the extended address records
+    ihex_result_t result;
+    uint32_t record_count;
+    bool in_record;
+    uint8_t hi_nibble;          // 0xFF if waiting for the high nibble
+    uint16_t rec_pos;           // decoded bytes in the current record
+    uint16_t rec_len;           // expected record length: 5 + byte count
+    uint8_t sum;
+    uint8_t rec[IHEX_MAX_DATA_LEN + 5]; // count, addrH, addrL, type, data..., chksum
+    ihex_result_t process_record(void);
+};
+
+// Formats one record ":LLAAAATT<data>CC" terminated with CR LF and NUL, like SpinASM writes it.
+// dst has to hold IHEX_RECORD_CHARS(len) + 1 chars, returns the number of chars without the NUL.
+size_t ihex_format_record(char *dst, uint8_t type, uint16_t addr, const uint8_t *data, uint8_t len);
+
+#endif // _IHEX_H
@@ -49,4 +49,5 @@ void setup()
 void loop()
 {
     server_process();
+    fv1.process();
 }
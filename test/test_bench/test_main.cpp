@@ -0,0 +1,357 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmarks of the FV1 core, results as one JSON document on stdout:
+//      pio test -e native -f test_bench -v
+// and into a file if FV1_BENCH_JSON is set, e.g. to compare two releases.
+// CPU bound cases are timed on the host clock, compare them between runs on the same machine.
+// The EEPROM burn runs on the virtual clock against the 24LC32A model.
+// Heap use is counted by wrapping malloc of the C library (glibc).
+
+#include <Arduino.h>
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "fv1_native.h"
+#include "eeprom_24lc32a.h"
+#include "fv1.h"
+#include "fv1_list.h"
+#include "ihex.h"
+#include "crc32.h"
+
+#define BENCH_MIN_NS        (200000000ull)  // repeat a case for at least 0.2 s
+#define BENCH_CHUNK_SIZE    (256u)          // file read chunk of FV1::load_file
+#define BENCH_BANK          "GA_DEMO.hex"
+#define LOOP_US             (100u)          // one pass of loop() serving the web and FTP clients
+#define LIST_FOLDERS        (10u)           // file system of the listing case, files in every folder
+#define LIST_FILES          (50u)
+
+FV1 fv1(14, 12);
+static Eeprom24LC32A chip(FV1_EEP_ADDR);
+
+static String results;
+static uint8_t image[FV1_IMAGE_SIZE];
+static uint8_t fv1_image[FV1_IMAGE_SIZE];   // BENCH_BANK as the burn has to write it
+static volatile uint32_t sink;      // keeps the measured work from being optimized out
+static int64_t heap_used;
+static int64_t heap_peak;
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+// -----------------------------------------------------------------------------------------------------
+static void heap_count(void *ptr, int sign)
+{
+    if (!ptr)
+        return;
+    heap_used += sign * (int64_t)malloc_usable_size(ptr);
+    if (heap_used > heap_peak)
+        heap_peak = heap_used;
+}
+// -----------------------------------------------------------------------------------------------------
+extern "C" void *malloc(size_t size)
+{
+    void *ptr = __libc_malloc(size);
+    heap_count(ptr, 1);
+    return ptr;
+}
+// -----------------------------------------------------------------------------------------------------
+extern "C" void *calloc(size_t n, size_t size)
+{
+    void *ptr = __libc_calloc(n, size);
+    heap_count(ptr, 1);
+    return ptr;
+}
+// -----------------------------------------------------------------------------------------------------
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    heap_count(ptr, -1);
+    void *res = __libc_realloc(ptr, size);
+    heap_count(res ? res : ptr, 1);
+    return res;
+}
+// -----------------------------------------------------------------------------------------------------
+extern "C" void free(void *ptr)
+{
+    heap_count(ptr, -1);
+    __libc_free(ptr);
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------
+static uint64_t host_ns(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+// -----------------------------------------------------------------------------------------------------
+static std::vector<uint8_t> read_host(const char *name)
+{
+    std::vector<uint8_t> data;
+    String path = String(FV1_DATA_DIR "/") + name;
+    FILE *f = fopen(path.c_str(), "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    int c;
+    while ((c = fgetc(f)) != EOF)
+        data.push_back(c);
+    fclose(f);
+    return data;
+}
+// -----------------------------------------------------------------------------------------------------
+static void bench_add(const char *format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (results.length())
+        results += ",\n";
+    results += "    ";
+    results += buf;
+}
+// -----------------------------------------------------------------------------------------------------
+static void bench_parse(const char *name)
+{
+    std::vector<uint8_t> hex = read_host(name);
+    IHexDecoder decoder;
+    uint32_t runs = 0;
+    uint64_t start = host_ns();
+    uint64_t elapsed;
+
+    do
+    {
+        // same chunking as a file read by load_file
+        decoder.begin(image, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+        for (size_t pos = 0; pos < hex.size(); pos += BENCH_CHUNK_SIZE)
+            decoder.feed(&hex[pos], min((size_t)BENCH_CHUNK_SIZE, hex.size() - pos));
+        TEST_ASSERT_EQUAL(IHEX_DONE, decoder.finish());
+        runs++;
+    } while ((elapsed = host_ns() - start) < BENCH_MIN_NS);
+    bench_add("{\"case\": \"parse\", \"file\": \"%s\", \"bytes\": %u, \"records\": %u, \"runs\": %u, \"ns_per_file\": %.0f, \"bytes_per_s\": %.0f}",
+              name, (unsigned)hex.size(), decoder.get_record_count(), runs, (double)elapsed / runs,
+              (double)hex.size() * runs * 1e9 / elapsed);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_parse_ga_demo(void)
+{
+    bench_parse("GA_DEMO.hex");
+}
+// -----------------------------------------------------------------------------------------------------
+void test_parse_oem1(void)
+{
+    bench_parse("OEM1.hex");
+}
+// -----------------------------------------------------------------------------------------------------
+void test_image_checksum(void)
+{
+    // per program CRC32 of a bank, done for every load and image check
+    uint32_t runs = 0;
+    uint64_t start = host_ns();
+    uint64_t elapsed;
+
+    for (uint32_t i = 0; i < FV1_IMAGE_SIZE; i++)
+        image[i] = i * 7;
+    do
+    {
+        for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+            sink = crc32_calc(&image[FV1_PRG_SIZE * i], FV1_PRG_SIZE);
+        runs++;
+    } while ((elapsed = host_ns() - start) < BENCH_MIN_NS);
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32_calc((const uint8_t *)"123456789", 9));
+    bench_add("{\"case\": \"image_crc32\", \"bytes\": %u, \"runs\": %u, \"ns_per_image\": %.0f, \"bytes_per_s\": %.0f}",
+              FV1_IMAGE_SIZE, runs, (double)elapsed / runs, (double)FV1_IMAGE_SIZE * runs * 1e9 / elapsed);
+}
+// -----------------------------------------------------------------------------------------------------
+static void bench_burn(const char *chip_state, uint32_t write_us, uint32_t i2c_hz, bool page_write)
+{
+    // virtual time of the whole burn on the 24LC32A model
+    chip.set_write_us(write_us);
+    TEST_ASSERT_TRUE(fv1.burn_start(FV1_EEP_ADDR, i2c_hz, page_write));
+    while (fv1.burn_busy())
+    {
+        fv1.process();
+        delayMicroseconds(LOOP_US);
+    }
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_DONE, stats.state);
+    TEST_ASSERT_EQUAL_MEMORY(chip.get_memory(), fv1_image, FV1_IMAGE_SIZE);
+    bench_add("{\"case\": \"burn\", \"file\": \"%s\", \"chip\": \"%s\", \"write_us\": %u, \"strategy\": \"%s\", "
+              "\"i2c_hz\": %u, \"pages_written\": %u, \"pages_skipped\": %u, \"burn_ms\": %u}",
+              BENCH_BANK, chip_state, write_us, stats.page_write ? "page" : "chunk", stats.i2c_hz,
+              stats.pages_written, stats.pages_skipped, stats.burn_ms);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_time(void)
+{
+    // Every write strategy on a blank chip, then a burn of a chip already holding the bank.
+    // Chunk writes wait the page write time, page writes poll: chips faster than the
+    // datasheet maximum only gain with polling.
+    const uint32_t clocks[] = {100000, 400000};
+    const uint32_t write_times[] = {EEP_24LC32A_WRITE_US, 2000};
+    uint8_t buf[BENCH_CHUNK_SIZE];
+    IHexDecoder decoder(fv1_image, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/" BENCH_BANK, "/" BENCH_BANK));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/" BENCH_BANK));
+    File hexfile = LittleFS.open("/" BENCH_BANK, "r");
+    size_t len;
+    while ((len = hexfile.read(buf, sizeof(buf))) > 0)
+        decoder.feed(buf, len);
+    hexfile.close();
+    TEST_ASSERT_EQUAL(IHEX_DONE, decoder.finish());
+    for (uint32_t write_us : write_times)
+    {
+        for (bool page_write : {false, true})
+        {
+            for (uint32_t i2c_hz : clocks)
+            {
+                chip.erase();
+                bench_burn("blank", write_us, i2c_hz, page_write);
+            }
+        }
+    }
+    bench_burn("same", EEP_24LC32A_WRITE_US, FV1_EEP_I2C_HZ, true);     // compare only
+}
+// -----------------------------------------------------------------------------------------------------
+static void bench_list(bool ascending, const std::vector<list_rec_t> &sorted)
+{
+    // file system listing of /?sort: time, directory passes and the heap taken on top of the file system
+    uint32_t runs = 0;
+    uint32_t passes = 0;
+    uint32_t batch_size = 0;
+    int64_t peak = 0;
+    uint64_t start = host_ns();
+    uint64_t elapsed;
+
+    do
+    {
+        std::vector<list_rec_t> got;
+        got.reserve(sorted.size());
+        int64_t heap_start = heap_used;
+        heap_peak = heap_used;
+        {
+            FileList list(ascending);
+            uint16_t count;
+            do
+            {
+                count = list.next();
+                for (uint16_t i = 0; i < count; i++)
+                    got.push_back(list.get_rec(i));
+            } while (count == list.get_size());
+            passes = list.get_passes();
+            batch_size = list.get_size();
+        }
+        peak = max(peak, heap_peak - heap_start);
+        TEST_ASSERT_EQUAL(sorted.size(), got.size());
+        for (size_t i = 0; i < got.size(); i++)
+        {
+            TEST_ASSERT_EQUAL_STRING(sorted[i].folder, got[i].folder);
+            TEST_ASSERT_EQUAL_STRING(sorted[i].name, got[i].name);
+        }
+        runs++;
+    } while ((elapsed = host_ns() - start) < BENCH_MIN_NS);
+#ifdef __GLIBC__
+    String heap = String((uint32_t)peak);
+#else
+    String heap = "null";
+#endif
+    bench_add("{\"case\": \"list\", \"order\": \"%s\", \"files\": %u, \"batch\": %u, \"passes\": %u, \"runs\": %u, "
+              "\"ns_per_list\": %.0f, \"peak_heap_bytes\": %s}",
+              ascending ? "ascending" : "descending", (unsigned)sorted.size(), batch_size, passes, runs,
+              (double)elapsed / runs, heap.c_str());
+}
+// -----------------------------------------------------------------------------------------------------
+void test_list_500_files(void)
+{
+    // the records of the listing have to come in the order of a full sort
+    std::vector<list_rec_t> sorted;
+    list_rec_t rec;
+
+    LittleFS.format();
+    for (uint32_t f = 0; f < LIST_FOLDERS; f++)
+    {
+        for (uint32_t n = 0; n < LIST_FILES; n++)
+        {
+            // mixed case names in a scrambled order
+            snprintf(rec.folder, sizeof(rec.folder), "Bank%02u", (unsigned)(f * 7 % LIST_FOLDERS));
+            snprintf(rec.name, sizeof(rec.name), "%s%03u.hex", n % 3 ? "prg" : "PRG", (unsigned)(n * 37 % LIST_FILES));
+            rec.size = 100 + n;
+            File file = LittleFS.open(String("/") + rec.folder + "/" + rec.name, "w");
+            file.write((const uint8_t *)image, rec.size);
+            file.close();
+            sorted.push_back(rec);
+        }
+    }
+    for (bool ascending : {true, false})
+    {
+        std::sort(sorted.begin(), sorted.end(), [ascending](const list_rec_t &a, const list_rec_t &b) {
+            int res = strcasecmp(a.folder, b.folder);
+            if (res)
+                return res < 0;
+            res = strcasecmp(a.name, b.name);
+            return ascending ? res < 0 : res > 0;
+        });
+        bench_list(ascending, sorted);
+    }
+    LittleFS.format();
+}
+// -----------------------------------------------------------------------------------------------------
+static void bench_write(void)
+{
+    String json = "{\n  \"suite\": \"fv1_bench\",\n  \"results\": [\n" + results + "\n  ]\n}\n";
+    printf("%s", json.c_str());
+    const char *path = getenv("FV1_BENCH_JSON");
+    if (!path)
+        return;
+    FILE *f = fopen(path, "w");
+    if (f)
+    {
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void setUp(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+void tearDown(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+int main(void)
+{
+    Wire.attach(&chip);
+    fv1.begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_ga_demo);
+    RUN_TEST(test_parse_oem1);
+    RUN_TEST(test_image_checksum);
+    RUN_TEST(test_burn_time);
+    RUN_TEST(test_list_500_files);
+    int failures = UNITY_END();
+    bench_write();
+    return failures;
+}
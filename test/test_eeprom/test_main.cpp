@@ -0,0 +1,325 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// 24LC32A model and the EEPROM burn of the FV1 class running against it.
+
+#include <Arduino.h>
+#include <unity.h>
+#include "fv1_native.h"
+#include "eeprom_24lc32a.h"
+#include "SparkFun_External_EEPROM.h"
+#include "fv1.h"
+#include "ihex.h"
+#include "crc32.h"
+
+#define LOOP_US             (100u)      // one pass of loop() serving the web and FTP clients
+#define TEST_BANK           "GA_DEMO.hex"
+
+FV1 fv1(14, 12);
+static Eeprom24LC32A chip(FV1_EEP_ADDR);
+static uint8_t bank[FV1_IMAGE_SIZE];    // decoded TEST_BANK
+extern ExternalEEPROM eep;
+
+// -----------------------------------------------------------------------------------------------------
+void test_load_bank(void)
+{
+    uint8_t buf[256];
+    IHexDecoder decoder(bank, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+    File hexfile;
+
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/" TEST_BANK, "/" TEST_BANK));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/" TEST_BANK));
+    hexfile = LittleFS.open("/" TEST_BANK, "r");
+    size_t len;
+    while ((len = hexfile.read(buf, sizeof(buf))) > 0)
+        decoder.feed(buf, len);
+    hexfile.close();
+    TEST_ASSERT_EQUAL(IHEX_DONE, decoder.finish());
+}
+// -----------------------------------------------------------------------------------------------------
+static void burn(bool page_write = true, bool force = false, uint32_t i2c_hz = FV1_EEP_I2C_HZ)
+{
+    TEST_ASSERT_TRUE(fv1.burn_start(FV1_EEP_ADDR, i2c_hz, page_write, force));
+    while (fv1.burn_busy())
+    {
+        fv1.process();
+        delayMicroseconds(LOOP_US);
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+static void write_bytes(uint16_t addr, const uint8_t *data, uint8_t len)
+{
+    Wire.beginTransmission(FV1_EEP_ADDR);
+    Wire.write(addr >> 8);
+    Wire.write(addr & 0xFF);
+    Wire.write(data, len);
+    TEST_ASSERT_EQUAL(0, Wire.endTransmission());
+}
+// -----------------------------------------------------------------------------------------------------
+void test_page_write_wraps_in_page(void)
+{
+    const uint8_t data[] = {1, 2, 3, 4};
+
+    write_bytes(0x0FFE, data, sizeof(data));
+    uint8_t *mem = chip.get_memory();
+    TEST_ASSERT_EQUAL(1, mem[0x0FFE]);
+    TEST_ASSERT_EQUAL(2, mem[0x0FFF]);
+    TEST_ASSERT_EQUAL(3, mem[0x0FE0]);      // start of the same page, not 0x0000
+    TEST_ASSERT_EQUAL(4, mem[0x0FE1]);
+    TEST_ASSERT_EQUAL(0xFF, mem[0x0000]);
+    TEST_ASSERT_EQUAL(1, chip.get_write_cycles());
+}
+// -----------------------------------------------------------------------------------------------------
+void test_write_cycle_nacks_address(void)
+{
+    const uint8_t data = 0x5A;
+
+    write_bytes(0x0100, &data, 1);
+    Wire.beginTransmission(FV1_EEP_ADDR);
+    TEST_ASSERT_EQUAL(2, Wire.endTransmission());
+    delayMicroseconds(EEP_24LC32A_WRITE_US / 2);
+    Wire.beginTransmission(FV1_EEP_ADDR);
+    TEST_ASSERT_EQUAL(2, Wire.endTransmission());
+    delayMicroseconds(EEP_24LC32A_WRITE_US / 2);
+    Wire.beginTransmission(FV1_EEP_ADDR);
+    TEST_ASSERT_EQUAL(0, Wire.endTransmission());
+    TEST_ASSERT_EQUAL(2, chip.get_busy_nacks());
+    TEST_ASSERT_EQUAL(data, chip.get_memory()[0x0100]);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_sequential_read_wraps_array(void)
+{
+    uint8_t *mem = chip.get_memory();
+    for (uint16_t i = 0; i < EEP_24LC32A_SIZE; i++)
+        mem[i] = i * 3;
+    // address high byte: the upper 4 bits are ignored
+    Wire.beginTransmission(FV1_EEP_ADDR);
+    Wire.write(0xFF);
+    Wire.write(0xFE);
+    TEST_ASSERT_EQUAL(0, Wire.endTransmission(false));
+    TEST_ASSERT_EQUAL(4, Wire.requestFrom(FV1_EEP_ADDR, 4));
+    TEST_ASSERT_EQUAL(mem[0x0FFE], Wire.read());
+    TEST_ASSERT_EQUAL(mem[0x0FFF], Wire.read());
+    TEST_ASSERT_EQUAL(mem[0x0000], Wire.read());
+    TEST_ASSERT_EQUAL(mem[0x0001], Wire.read());
+    TEST_ASSERT_EQUAL(0, chip.get_write_cycles());
+}
+// -----------------------------------------------------------------------------------------------------
+void test_library_write_read(void)
+{
+    // chunked library write across page lines, then one sequential read
+    ExternalEEPROM mem;
+    uint8_t data[100];
+    uint8_t back[sizeof(data)];
+
+    for (uint8_t i = 0; i < sizeof(data); i++)
+        data[i] = i ^ 0xA5;
+    mem.setMemorySize(EEP_24LC32A_SIZE);
+    mem.setPageSize(EEP_24LC32A_PAGE_SIZE);
+    TEST_ASSERT_TRUE(mem.begin(FV1_EEP_ADDR, Wire));
+    mem.write(0x0110, data, sizeof(data));
+    mem.read(0x0110, back, sizeof(back));
+    TEST_ASSERT_EQUAL_MEMORY(data, back, sizeof(data));
+    TEST_ASSERT_EQUAL_MEMORY(data, chip.get_memory() + 0x0110, sizeof(data));
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_blank_chip(void)
+{
+    uint32_t crc[FV1_PRG_COUNT];
+
+    burn();
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_DONE, stats.state);
+    TEST_ASSERT_EQUAL(FV1_EEP_PAGES, stats.pages_written);
+    TEST_ASSERT_EQUAL(FV1_IMAGE_SIZE, stats.bytes_verified);
+    TEST_ASSERT_EQUAL(FV1_EEP_PAGES, chip.get_write_cycles());
+    TEST_ASSERT_EQUAL_MEMORY(bank, chip.get_memory(), FV1_IMAGE_SIZE);
+    // every page takes at least one write cycle
+    TEST_ASSERT_GREATER_OR_EQUAL(FV1_EEP_PAGES * EEP_24LC32A_WRITE_US / 1000, stats.burn_ms);
+    TEST_ASSERT_TRUE(fv1.eep_prg_crc(FV1_EEP_ADDR, crc));
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        TEST_ASSERT_EQUAL_HEX32(fv1.get_prg_crc(i), crc[i]);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_skips_matching_pages(void)
+{
+    memcpy(chip.get_memory(), bank, FV1_IMAGE_SIZE);
+    chip.get_memory()[0x0421] ^= 0x10;
+    burn();
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_DONE, stats.state);
+    TEST_ASSERT_EQUAL(1, stats.pages_written);
+    TEST_ASSERT_EQUAL(FV1_EEP_PAGES - 1, stats.pages_skipped);
+    TEST_ASSERT_EQUAL(1, chip.get_write_cycles());
+    TEST_ASSERT_EQUAL_MEMORY(bank, chip.get_memory(), FV1_IMAGE_SIZE);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_retries_flipped_bit(void)
+{
+    chip.set_bit_flip(0x0203, 0x08, 1);
+    burn();
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_DONE, stats.state);
+    TEST_ASSERT_EQUAL(1, stats.retries);
+    TEST_ASSERT_EQUAL(1, fv1.get_burn_retries(0x0203 / FV1_EEP_PAGE_SIZE));
+    TEST_ASSERT_EQUAL_MEMORY(bank, chip.get_memory(), FV1_IMAGE_SIZE);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_fails_on_weak_cell(void)
+{
+    chip.set_bit_flip(0x0203, 0x08, UINT32_MAX);
+    burn();
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_ERROR, stats.state);
+    TEST_ASSERT_EQUAL(0x0203 / FV1_EEP_PAGE_SIZE, stats.failed_page);
+    TEST_ASSERT_EQUAL(FV1_EEP_RETRIES, stats.retries);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_stuck_write_cycle(void)
+{
+    chip.set_stuck(true);
+    burn();
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_ERROR, stats.state);
+    TEST_ASSERT_EQUAL(-1, stats.failed_page);
+    TEST_ASSERT_EQUAL(1, chip.get_write_cycles());
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_stuck_chunk_mode(void)
+{
+    // The library write path must not poll a chip that never comes back. Half pages: a page
+    // goes out in two chunks, as with a 32 byte I2C buffer (30 bytes per chunk).
+    eep.setPageSize(FV1_EEP_PAGE_SIZE / 2);
+    chip.set_stuck(true);
+    burn(false);
+    eep.setPageSize(FV1_EEP_PAGE_SIZE);
+    TEST_ASSERT_EQUAL(FV1_BURN_ERROR, fv1.get_burn_stats().state);
+    TEST_ASSERT_EQUAL(1, chip.get_write_cycles());
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_chunk_mode(void)
+{
+    burn(false);
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_DONE, stats.state);
+    TEST_ASSERT_FALSE(stats.page_write);
+    TEST_ASSERT_EQUAL(FV1_EEP_PAGES, stats.pages_written);
+    TEST_ASSERT_EQUAL_MEMORY(bank, chip.get_memory(), FV1_IMAGE_SIZE);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_standard_mode(void)
+{
+    // at 100 kHz the compare read and the page transfer take ~6 ms before the write cycle
+    burn(true, false, 100000);
+    TEST_ASSERT_EQUAL(FV1_BURN_DONE, fv1.get_burn_stats().state);
+    TEST_ASSERT_EQUAL_MEMORY(bank, chip.get_memory(), FV1_IMAGE_SIZE);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_load_refused_while_burning(void)
+{
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/OEM1.hex", "/OEM1.hex"));
+    TEST_ASSERT_TRUE(fv1.burn_start(FV1_EEP_ADDR));
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        fv1.process();
+        delayMicroseconds(LOOP_US);
+    }
+    TEST_ASSERT_TRUE(fv1.burn_busy());
+    TEST_ASSERT_EQUAL(FV1_OTHER_ERR, fv1.load_file("/OEM1.hex"));
+    while (fv1.burn_busy())
+    {
+        fv1.process();
+        delayMicroseconds(LOOP_US);
+    }
+    TEST_ASSERT_EQUAL(FV1_BURN_DONE, fv1.get_burn_stats().state);
+    TEST_ASSERT_EQUAL_MEMORY(bank, chip.get_memory(), FV1_IMAGE_SIZE);
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        TEST_ASSERT_EQUAL_HEX32(crc32_calc(&bank[FV1_PRG_SIZE * i], FV1_PRG_SIZE), fv1.get_prg_crc(i));
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_slow_write_cycle(void)
+{
+    // up to twice the page write time is waited for
+    chip.set_write_us(8000);
+    burn();
+    TEST_ASSERT_EQUAL(FV1_BURN_DONE, fv1.get_burn_stats().state);
+    TEST_ASSERT_EQUAL_MEMORY(bank, chip.get_memory(), FV1_IMAGE_SIZE);
+    chip.erase();
+    chip.set_write_us(12000);
+    burn();
+    TEST_ASSERT_EQUAL(FV1_BURN_ERROR, fv1.get_burn_stats().state);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_no_chip(void)
+{
+    chip.set_present(false);
+    burn();
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_ERROR, stats.state);
+    TEST_ASSERT_GREATER_OR_EQUAL(FV1_EEP_DETECT_MS, stats.burn_ms);
+    TEST_ASSERT_EQUAL(0, stats.pages_written);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_burn_chip_removed(void)
+{
+    // pulled out of the socket in the middle of the burn
+    TEST_ASSERT_TRUE(fv1.burn_start(FV1_EEP_ADDR));
+    while (fv1.burn_busy())
+    {
+        if (fv1.get_burn_stats().pages_written == 10)
+            chip.set_present(false);
+        fv1.process();
+        delayMicroseconds(LOOP_US);
+    }
+    const fv1_burn_stats_t &stats = fv1.get_burn_stats();
+    TEST_ASSERT_EQUAL(FV1_BURN_ERROR, stats.state);
+    TEST_ASSERT_LESS_OR_EQUAL(11, stats.pages_written);
+}
+// -----------------------------------------------------------------------------------------------------
+void setUp(void)
+{
+    chip = Eeprom24LC32A(FV1_EEP_ADDR);
+}
+// -----------------------------------------------------------------------------------------------------
+void tearDown(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+int main(void)
+{
+    Wire.attach(&chip);
+    fv1.begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_load_bank);
+    RUN_TEST(test_page_write_wraps_in_page);
+    RUN_TEST(test_write_cycle_nacks_address);
+    RUN_TEST(test_sequential_read_wraps_array);
+    RUN_TEST(test_library_write_read);
+    RUN_TEST(test_burn_blank_chip);
+    RUN_TEST(test_burn_skips_matching_pages);
+    RUN_TEST(test_burn_retries_flipped_bit);
+    RUN_TEST(test_burn_fails_on_weak_cell);
+    RUN_TEST(test_burn_stuck_write_cycle);
+    RUN_TEST(test_burn_stuck_chunk_mode);
+    RUN_TEST(test_burn_chunk_mode);
+    RUN_TEST(test_burn_standard_mode);
+    RUN_TEST(test_load_refused_while_burning);
+    RUN_TEST(test_burn_slow_write_cycle);
+    RUN_TEST(test_burn_no_chip);
+    RUN_TEST(test_burn_chip_removed);
+    return UNITY_END();
+}
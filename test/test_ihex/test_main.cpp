@@ -0,0 +1,245 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Streaming Intel HEX decoder against a line by line reference decoder (strtol per byte,
+// the way load_file worked before), for every chunk size a file read or upload can deliver.
+// Throughput is measured in test_bench.
+
+#include <Arduino.h>
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "fv1_native.h"
+#include "fv1.h"
+#include "ihex.h"
+
+static uint8_t image[FV1_IMAGE_SIZE];
+static uint8_t ref_image[FV1_IMAGE_SIZE];
+
+// -----------------------------------------------------------------------------------------------------
+static std::string read_host(const char *name)
+{
+    std::string data;
+    String path = String(FV1_DATA_DIR "/") + name;
+    FILE *f = fopen(path.c_str(), "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    int c;
+    while ((c = fgetc(f)) != EOF)
+        data += (char)c;
+    fclose(f);
+    return data;
+}
+// -----------------------------------------------------------------------------------------------------
+static uint32_t hex_value(const std::string &line, size_t pos, size_t digits)
+{
+    return strtoul(line.substr(pos, digits).c_str(), NULL, 16);
+}
+// -----------------------------------------------------------------------------------------------------
+static ihex_result_t ref_decode(const std::string &hex, uint8_t *dst, uint32_t &records)
+{
+    // data and EOF records only, 16 bit addresses, any line ending
+    size_t pos = 0;
+    records = 0;
+    while (pos < hex.size())
+    {
+        size_t end = hex.find_first_of("\r\n", pos);
+        std::string line = hex.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = end == std::string::npos ? hex.size() : end + 1;
+        if (line.empty())
+            continue;
+        if (line[0] != ':' || line.size() < 11)
+            return IHEX_ERR_FORMAT;
+        uint32_t count = hex_value(line, 1, 2);
+        uint32_t addr = hex_value(line, 3, 4);
+        uint32_t type = hex_value(line, 7, 2);
+        if (line.size() < 11 + 2 * count)
+            return IHEX_ERR_FORMAT;
+        uint8_t sum = count + (addr >> 8) + addr + type + hex_value(line, 9 + 2 * count, 2);
+        records++;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint8_t value = hex_value(line, 9 + 2 * i, 2);
+            sum += value;
+            if (type == 0x00)
+            {
+                if (addr + i >= FV1_IMAGE_SIZE)
+                    return IHEX_ERR_ADDRESS;
+                dst[addr + i] = value;
+            }
+        }
+        if (sum)
+            return IHEX_ERR_CHKSUM;
+        if (type == 0x01)
+            return IHEX_DONE;
+        if (type != 0x00)
+            return IHEX_ERR_FORMAT;
+    }
+    return IHEX_ERR_FORMAT;
+}
+// -----------------------------------------------------------------------------------------------------
+static ihex_result_t decode(const std::string &hex, size_t chunk, IHexDecoder &decoder)
+{
+    decoder.begin(image, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+    for (size_t pos = 0; pos < hex.size(); pos += chunk)
+        decoder.feed((const uint8_t *)&hex[pos], min(chunk, hex.size() - pos));
+    return decoder.finish();
+}
+// -----------------------------------------------------------------------------------------------------
+static void check_file(const char *name)
+{
+    std::string hex = read_host(name);
+    const size_t chunks[] = {1, 7, 43, 256, hex.size()};
+    uint32_t ref_records;
+    IHexDecoder decoder;
+
+    memset(ref_image, 0, sizeof(ref_image));
+    TEST_ASSERT_EQUAL(IHEX_DONE, ref_decode(hex, ref_image, ref_records));
+    for (size_t chunk : chunks)
+    {
+        memset(image, 0, sizeof(image));
+        TEST_ASSERT_EQUAL(IHEX_DONE, decode(hex, chunk, decoder));
+        TEST_ASSERT_EQUAL(ref_records, decoder.get_record_count());
+        TEST_ASSERT_EQUAL_HEX32(0xFF, decoder.get_block_mask());
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(ref_image, image, FV1_IMAGE_SIZE);
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void test_decode_ga_demo(void)
+{
+    check_file("GA_DEMO.hex");
+}
+// -----------------------------------------------------------------------------------------------------
+void test_decode_oem1(void)
+{
+    check_file("OEM1.hex");
+}
+// -----------------------------------------------------------------------------------------------------
+void test_line_endings(void)
+{
+    // CRLF (SpinASM), LF and old Mac CR files decode to the same image
+    std::string hex = read_host("GA_DEMO.hex");
+    std::string lf, cr;
+    IHexDecoder decoder;
+
+    for (char c : hex)
+    {
+        if (c == '\r')
+            continue;
+        lf += c;
+        cr += c == '\n' ? '\r' : c;
+    }
+    memset(ref_image, 0, sizeof(ref_image));
+    TEST_ASSERT_EQUAL(IHEX_DONE, decode(hex, 256, decoder));
+    memcpy(ref_image, image, sizeof(image));
+    memset(image, 0, sizeof(image));
+    TEST_ASSERT_EQUAL(IHEX_DONE, decode(lf, 256, decoder));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref_image, image, FV1_IMAGE_SIZE);
+    memset(image, 0, sizeof(image));
+    TEST_ASSERT_EQUAL(IHEX_DONE, decode(cr, 256, decoder));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ref_image, image, FV1_IMAGE_SIZE);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_broken_files(void)
+{
+    std::string hex = read_host("GA_DEMO.hex");
+    IHexDecoder decoder;
+    uint32_t records;
+
+    std::string chksum = hex;
+    chksum[9] = chksum[9] == '0' ? '1' : '0';       // first data digit
+    TEST_ASSERT_EQUAL(IHEX_ERR_CHKSUM, decode(chksum, 256, decoder));
+    TEST_ASSERT_EQUAL(IHEX_ERR_CHKSUM, ref_decode(chksum, ref_image, records));
+
+    std::string garbage = hex;
+    garbage[5] = 'x';
+    TEST_ASSERT_EQUAL(IHEX_ERR_FORMAT, decode(garbage, 256, decoder));
+
+    std::string no_eof = hex.substr(0, hex.rfind(':'));
+    TEST_ASSERT_EQUAL(IHEX_ERR_FORMAT, decode(no_eof, 256, decoder));
+    TEST_ASSERT_EQUAL(IHEX_ERR_FORMAT, ref_decode(no_eof, ref_image, records));
+
+    std::string truncated = hex.substr(0, hex.size() / 2);
+    TEST_ASSERT_EQUAL(IHEX_ERR_FORMAT, decode(truncated, 256, decoder));
+}
+// -----------------------------------------------------------------------------------------------------
+void test_format_record(void)
+{
+    // formatted records decode to the same bytes
+    uint8_t data[4] = {0x01, 0x02, 0xAB, 0xFF};
+    char buf[IHEX_RECORD_CHARS(sizeof(data)) + IHEX_RECORD_CHARS(0) + 1];
+    IHexDecoder decoder;
+
+    size_t len = ihex_format_record(buf, 0x00, 0x0FFC, data, sizeof(data));
+    TEST_ASSERT_EQUAL(IHEX_RECORD_CHARS(sizeof(data)), len);
+    TEST_ASSERT_EQUAL_STRING(":040FFC000102ABFF44\r\n", buf);
+    len += ihex_format_record(&buf[len], 0x01, 0, NULL, 0);
+    TEST_ASSERT_EQUAL_STRING(":00000001FF\r\n", &buf[IHEX_RECORD_CHARS(sizeof(data))]);
+    memset(image, 0, sizeof(image));
+    TEST_ASSERT_EQUAL(IHEX_DONE, decode(std::string(buf, len), len, decoder));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, &image[0x0FFC], sizeof(data));
+    TEST_ASSERT_EQUAL_HEX32(0x80, decoder.get_block_mask());
+}
+// -----------------------------------------------------------------------------------------------------
+void test_wrapping_address(void)
+{
+    // base 0xFFFF0000 + 0xFFF0: address + count wraps around 32 bits to the start of the image
+    const char *hex = ":02000004FFFFFC\r\n"
+                      ":10FFF000000102030405060708090A0B0C0D0E0F89\r\n"
+                      ":00000001FF\r\n";
+    IHexDecoder decoder;
+
+    memset(image, 0, sizeof(image));
+    TEST_ASSERT_EQUAL(IHEX_ERR_ADDRESS, decode(hex, strlen(hex), decoder));
+    TEST_ASSERT_EQUAL_HEX32(0, decoder.get_block_mask());
+    for (uint32_t i = 0; i < FV1_IMAGE_SIZE; i++)
+        TEST_ASSERT_EQUAL(0, image[i]);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_address_bounds(void)
+{
+    // the last byte of the image is fine, one more is not
+    const char *last = ":010FFF00AA47\r\n:00000001FF\r\n";
+    const char *past = ":020FFF00AABB8B\r\n:00000001FF\r\n";
+    IHexDecoder decoder;
+
+    TEST_ASSERT_EQUAL(IHEX_DONE, decode(last, strlen(last), decoder));
+    TEST_ASSERT_EQUAL(0xAA, image[FV1_IMAGE_SIZE - 1]);
+    TEST_ASSERT_EQUAL(IHEX_ERR_ADDRESS, decode(past, strlen(past), decoder));
+}
+// -----------------------------------------------------------------------------------------------------
+void setUp(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+void tearDown(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_decode_ga_demo);
+    RUN_TEST(test_decode_oem1);
+    RUN_TEST(test_line_endings);
+    RUN_TEST(test_broken_files);
+    RUN_TEST(test_format_record);
+    RUN_TEST(test_wrapping_address);
+    RUN_TEST(test_address_bounds);
+    return UNITY_END();
+}
@@ -0,0 +1,363 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Bank loading of the FV1 class: hex file, image next to it and the RAM cache.
+// Single programs picked from a file are checked at the FV-1 end against a full decode.
+
+#include <Arduino.h>
+#include <unity.h>
+#include <string>
+#include "fv1_native.h"
+#include "fv1_master.h"
+#include "fv1.h"
+#include "ihex.h"
+#include "crc32.h"
+
+FV1 fv1(14, 12);
+static Fv1Master master;
+static uint8_t ga_demo[FV1_IMAGE_SIZE];     // decoded banks
+static uint8_t oem1[FV1_IMAGE_SIZE];
+
+// -----------------------------------------------------------------------------------------------------
+static void decode_bank(const char *name, uint8_t *image)
+{
+    uint8_t buf[256];
+    IHexDecoder decoder(image, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+    String path = String("/") + name;
+
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, (String(FV1_DATA_DIR) + path).c_str(), path));
+    File hexfile = LittleFS.open(path, "r");
+    size_t len;
+    while ((len = hexfile.read(buf, sizeof(buf))) > 0)
+        decoder.feed(buf, len);
+    hexfile.close();
+    TEST_ASSERT_EQUAL(IHEX_DONE, decoder.finish());
+}
+// -----------------------------------------------------------------------------------------------------
+static std::string format_prg(const uint8_t *image, uint8_t prg)
+{
+    // one instruction per record, like SpinASM writes them
+    char buf[IHEX_RECORD_CHARS(4) + 1];
+    std::string hex;
+    for (uint32_t addr = FV1_PRG_SIZE * prg; addr < FV1_PRG_SIZE * (prg + 1u); addr += 4)
+    {
+        ihex_format_record(buf, 0x00, addr, &image[addr], 4);
+        hex += buf;
+    }
+    return hex;
+}
+// -----------------------------------------------------------------------------------------------------
+static void write_file(const String &path, const std::string &data)
+{
+    File f = LittleFS.open(path, "w");
+    TEST_ASSERT_EQUAL(data.size(), f.write((const uint8_t *)data.data(), data.size()));
+    f.close();
+}
+// -----------------------------------------------------------------------------------------------------
+static void check_prg(const uint8_t *image, uint8_t prg)
+{
+    TEST_ASSERT_EQUAL_HEX32(crc32_calc(&image[FV1_PRG_SIZE * prg], FV1_PRG_SIZE), fv1.get_prg_crc(prg));
+}
+// -----------------------------------------------------------------------------------------------------
+void test_load_banks(void)
+{
+    decode_bank("GA_DEMO.hex", ga_demo);
+    decode_bank("OEM1.hex", oem1);
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/OEM1.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/GA_DEMO.hex"));
+    TEST_ASSERT_TRUE(fv1.get_fw_loaded());
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        check_prg(ga_demo, i);
+    TEST_ASSERT_TRUE(LittleFS.exists(FV1::image_path("/GA_DEMO.hex")));
+}
+// -----------------------------------------------------------------------------------------------------
+void test_partial_file(void)
+{
+    // only program 2 is replaced
+    char eof[IHEX_RECORD_CHARS(0) + 1];
+    ihex_format_record(eof, 0x01, 0, NULL, 0);
+    write_file("/prg2.hex", format_prg(oem1, 2) + eof);
+
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/GA_DEMO.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/prg2.hex"));
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        check_prg(i == 2 ? oem1 : ga_demo, i);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_broken_file_keeps_bank(void)
+{
+    // seven good programs of OEM1, then a checksum error: nothing of it may be enabled
+    char eof[IHEX_RECORD_CHARS(0) + 1];
+    ihex_format_record(eof, 0x01, 0, NULL, 0);
+    std::string hex;
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        hex += format_prg(oem1, i);
+    hex[hex.size() - 3] ^= 1;   // checksum of the last record
+    write_file("/broken.hex", hex + eof);
+
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/GA_DEMO.hex"));
+    TEST_ASSERT_EQUAL(FV1_INPUT_FILE_CHKSUM_ERR, fv1.load_file("/broken.hex"));
+    TEST_ASSERT_TRUE(fv1.get_fw_loaded());
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        check_prg(ga_demo, i);
+    TEST_ASSERT_FALSE(LittleFS.exists(FV1::image_path("/broken.hex")));
+    TEST_ASSERT_EQUAL(FV1_INPUT_FILE_NOT_FOUND, fv1.load_file("/missing.hex"));
+    check_prg(ga_demo, 0);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_damaged_image(void)
+{
+    // program 5 of the image does not match its CRC: the hex file is decoded again
+    String img_path = FV1::image_path("/OEM1.hex");
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/OEM1.hex"));
+    File img = LittleFS.open(img_path, "r+");
+    TEST_ASSERT_TRUE(img.seek(sizeof(fv1_image_hdr_t) + FV1_PRG_SIZE * 5 + 10));
+    img.write(oem1[FV1_PRG_SIZE * 5 + 10] ^ 0x40);
+    img.close();
+
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/GA_DEMO.hex"));
+    uint32_t misses = fv1.get_image_misses();
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/OEM1.hex"));
+    TEST_ASSERT_EQUAL(misses + 1, fv1.get_image_misses());
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        check_prg(oem1, i);
+    // rebuilt
+    uint32_t hits = fv1.get_image_hits();
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/OEM1.hex"));
+    TEST_ASSERT_EQUAL(hits + 1, fv1.get_image_hits());
+}
+// -----------------------------------------------------------------------------------------------------
+static void check_pick(const char *path, const uint8_t *image)
+{
+    // every program as received by the FV-1, the enabled bank stays as it is
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+    {
+        TEST_ASSERT_TRUE(fv1.set_prg(path, i));
+        delay(1);   // STOP
+        TEST_ASSERT_TRUE(master.get_result().done);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(&image[FV1_PRG_SIZE * i], master.get_data(), FV1_PRG_SIZE);
+    }
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        check_prg(ga_demo, i);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_pick_from_image(void)
+{
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/GA_DEMO.hex"));
+    TEST_ASSERT_TRUE(LittleFS.exists(FV1::image_path("/OEM1.hex")));
+    check_pick("/OEM1.hex", oem1);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_pick_decodes_once(void)
+{
+    // no image: the first pick decodes the whole file and stores the image for the next ones
+    String img_path = FV1::image_path("/OEM1.hex");
+    LittleFS.remove(img_path);
+    TEST_ASSERT_TRUE(fv1.set_prg("/OEM1.hex", 6));
+    TEST_ASSERT_TRUE(LittleFS.exists(img_path));
+    check_pick("/OEM1.hex", oem1);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_pick_from_cache(void)
+{
+    fv1.get_cache().set_budget(FV1_CACHE_BUDGET);
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/OEM1.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/GA_DEMO.hex"));
+    LittleFS.remove(FV1::image_path("/OEM1.hex"));
+    uint32_t hits = fv1.get_cache().get_hits();
+    check_pick("/OEM1.hex", oem1);
+    TEST_ASSERT_EQUAL(hits + FV1_PRG_COUNT, fv1.get_cache().get_hits());
+    TEST_ASSERT_FALSE(LittleFS.exists(FV1::image_path("/OEM1.hex")));
+    fv1.get_cache().set_budget(0);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_pick_partial_file(void)
+{
+    TEST_ASSERT_TRUE(fv1.set_prg("/prg2.hex", 2));
+    delay(1);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&oem1[FV1_PRG_SIZE * 2], master.get_data(), FV1_PRG_SIZE);
+    TEST_ASSERT_FALSE(fv1.set_prg("/prg2.hex", 3));     // not in the file
+    TEST_ASSERT_FALSE(fv1.set_prg("/broken.hex", 0));
+    TEST_ASSERT_FALSE(fv1.set_prg("/OEM1.hex", FV1_PRG_COUNT));
+}
+// -----------------------------------------------------------------------------------------------------
+void test_request_queue(void)
+{
+    // /program and /press requests are run from loop(), only the latest one
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/GA_DEMO.hex"));
+    uint32_t coalesced = fv1.get_prg_request().coalesced;
+    fv1.request_prg(1);
+    uint32_t seq = fv1.request_prg("/OEM1.hex", 4);
+    TEST_ASSERT_TRUE(fv1.get_prg_request().pending);
+    fv1.process();
+    delay(1);
+    const fv1_prg_request_t &req = fv1.get_prg_request();
+    TEST_ASSERT_FALSE(req.pending);
+    TEST_ASSERT_EQUAL(seq, req.done_seq);
+    TEST_ASSERT_EQUAL(coalesced + 1, req.coalesced);
+    TEST_ASSERT_TRUE(req.done_ok);
+    TEST_ASSERT_EQUAL_STRING("/OEM1.hex", req.done_path.c_str());
+    TEST_ASSERT_EQUAL(4, req.done_prg);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&oem1[FV1_PRG_SIZE * 4], master.get_data(), FV1_PRG_SIZE);
+
+    fv1.request_prg(2);
+    fv1.process();
+    delay(1);
+    TEST_ASSERT_TRUE(req.done_ok);
+    TEST_ASSERT_EQUAL(0, req.done_path.length());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(&ga_demo[FV1_PRG_SIZE * 2], master.get_data(), FV1_PRG_SIZE);
+
+    fv1.request_prg("/missing.hex", 0);
+    fv1.process();
+    TEST_ASSERT_FALSE(req.done_ok);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_drop_cache(void)
+{
+    // OEM1.hex overwritten with GA_DEMO.hex in the same second: same size and mtime
+    fv1.get_cache().set_budget(FV1_CACHE_BUDGET);
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/OEM1.hex", "/lib/bank.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/lib/bank.hex"));
+    File hexfile = LittleFS.open("/lib/bank.hex", "r");
+    uint32_t size = hexfile.size();
+    time_t mtime = hexfile.getLastWrite();
+    hexfile.close();
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/GA_DEMO.hex", "/lib/bank.hex"));
+    hexfile = LittleFS.open("/lib/bank.hex", "r");
+    TEST_ASSERT_EQUAL(size, hexfile.size());
+    TEST_ASSERT_EQUAL(mtime, hexfile.getLastWrite());
+    hexfile.close();
+
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/lib/bank.hex"));
+    check_prg(oem1, 0);         // stale
+    fv1.drop_cache("/lib/bank.hex");
+    LittleFS.remove(FV1::image_path("/lib/bank.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/lib/bank.hex"));
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        check_prg(ga_demo, i);
+
+    // everything below a folder, not the files next to it
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/OEM1.hex"));
+    TEST_ASSERT_EQUAL(2, fv1.get_cache().get_entries());
+    fv1.drop_cache("/li");
+    TEST_ASSERT_EQUAL(2, fv1.get_cache().get_entries());
+    fv1.drop_cache("/lib");
+    TEST_ASSERT_EQUAL(1, fv1.get_cache().get_entries());
+    fv1.drop_cache("/");
+    TEST_ASSERT_EQUAL(0, fv1.get_cache().get_entries());
+    fv1.get_cache().set_budget(0);
+}
+// -----------------------------------------------------------------------------------------------------
+static void overwrite_same_second(const String &path, const char *name)
+{
+    File hexfile = LittleFS.open(path, "r");
+    uint32_t size = hexfile.size();
+    time_t mtime = hexfile.getLastWrite();
+    hexfile.close();
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, (String(FV1_DATA_DIR "/") + name).c_str(), path));
+    hexfile = LittleFS.open(path, "r");
+    TEST_ASSERT_EQUAL(size, hexfile.size());
+    TEST_ASSERT_EQUAL(mtime, hexfile.getLastWrite());
+    hexfile.close();
+}
+// -----------------------------------------------------------------------------------------------------
+void test_drop_cache_spelling(void)
+{
+    // enabled from the page as "folder/name", changed over FTP as "/folder/name"
+    fv1.get_cache().set_budget(FV1_CACHE_BUDGET);
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/OEM1.hex", "/lib/bank.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("lib/bank.hex"));
+    overwrite_same_second("/lib/bank.hex", "GA_DEMO.hex");
+    fv1.drop_cache("/lib/bank.hex");
+    LittleFS.remove(FV1::image_path("/lib/bank.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("lib/bank.hex"));
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        check_prg(ga_demo, i);
+
+    // uploaded to the root as "//name"
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/OEM1.hex", "/root.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("root.hex"));
+    overwrite_same_second("//root.hex", "GA_DEMO.hex");
+    fv1.drop_cache("//root.hex");
+    LittleFS.remove(FV1::image_path("//root.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/root.hex"));
+    for (uint8_t i = 0; i < FV1_PRG_COUNT; i++)
+        check_prg(ga_demo, i);
+
+    fv1.drop_cache("lib/");
+    TEST_ASSERT_EQUAL(1, fv1.get_cache().get_entries());
+    fv1.drop_cache("/root.hex");
+    TEST_ASSERT_EQUAL(0, fv1.get_cache().get_entries());
+    fv1.get_cache().set_budget(0);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_user_bin_kept(void)
+{
+    // a raw EEPROM image of the user next to the hex file is neither replaced nor hidden
+    const std::string user_bin(FV1_IMAGE_SIZE, '\x5a');
+    write_file("/prog.bin", user_bin);
+    TEST_ASSERT_FALSE(FV1::is_image_path("/prog.bin"));
+    TEST_ASSERT_TRUE(FV1::is_image_path(FV1::image_path("/prog.hex")));
+
+    // upload: the image of the previous version is dropped, the new one decoded
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/OEM1.hex", "/prog.hex"));
+    LittleFS.remove(FV1::image_path("/prog.hex"));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/prog.hex"));
+    TEST_ASSERT_TRUE(LittleFS.exists(FV1::image_path("/prog.hex")));
+
+    // delete: the hex file and its image
+    LittleFS.remove("/prog.hex");
+    LittleFS.remove(FV1::image_path("/prog.hex"));
+    TEST_ASSERT_FALSE(LittleFS.exists(FV1::image_path("/prog.hex")));
+
+    File f = LittleFS.open("/prog.bin", "r");
+    TEST_ASSERT_EQUAL(user_bin.size(), f.size());
+    std::string data(f.size(), '\0');
+    f.read((uint8_t *)&data[0], data.size());
+    f.close();
+    TEST_ASSERT_TRUE(data == user_bin);
+    LittleFS.remove("/prog.bin");
+}
+// -----------------------------------------------------------------------------------------------------
+void setUp(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+void tearDown(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+int main(void)
+{
+    native_gpio_attach(&master);
+    fv1.begin();
+    fv1.get_cache().set_budget(0);      // every load reads the file system
+    UNITY_BEGIN();
+    RUN_TEST(test_load_banks);
+    RUN_TEST(test_partial_file);
+    RUN_TEST(test_broken_file_keeps_bank);
+    RUN_TEST(test_damaged_image);
+    RUN_TEST(test_pick_from_image);
+    RUN_TEST(test_pick_decodes_once);
+    RUN_TEST(test_pick_from_cache);
+    RUN_TEST(test_pick_partial_file);
+    RUN_TEST(test_request_queue);
+    RUN_TEST(test_drop_cache);
+    RUN_TEST(test_drop_cache_spelling);
+    RUN_TEST(test_user_bin_kept);
+    return UNITY_END();
+}
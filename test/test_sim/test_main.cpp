@@ -0,0 +1,291 @@
+/*
+ * FV-1 devRemote - remote programmer for the SpinSemi FV1 DSP
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Program transfer of trig_read against the FV-1 master model, cycle by cycle on the
+// virtual clock. Besides the checks, the highest SCL rate at which the 512 bytes still
+// arrive bit-exact is searched and reported as one JSON document on stdout:
+//      pio test -e native -f test_sim -v
+// and into a file if FV1_SIM_JSON is set. The margin depends on the GPIO access costs
+// of native_cpu, calibrate them against a real unit before trusting absolute numbers.
+
+#include <Arduino.h>
+#include <unity.h>
+#include <stdio.h>
+#include "fv1_native.h"
+#include "fv1_master.h"
+#include "fv1.h"
+#include "ihex.h"
+
+#define TEST_BANK           "GA_DEMO.hex"
+#define SIM_HZ_MIN          (100000u)       // must pass
+#define SIM_HZ_MAX          (10000000u)     // must fail
+#define SIM_HZ_STEP         (1000u)         // resolution of the search
+#define SIM_SEEDS           (8u)            // jitter sequences tried per rate
+
+FV1 fv1(14, 12);
+static Fv1Master master;
+static fv1_master_cfg_t master_defaults;
+static uint8_t bank[FV1_IMAGE_SIZE];        // decoded TEST_BANK
+static String results;
+
+// -----------------------------------------------------------------------------------------------------
+void test_load_bank(void)
+{
+    uint8_t buf[256];
+    IHexDecoder decoder(bank, FV1_IMAGE_SIZE, FV1_PRG_SIZE);
+    File hexfile;
+
+    TEST_ASSERT_TRUE(native_fs_load(LittleFS, FV1_DATA_DIR "/" TEST_BANK, "/" TEST_BANK));
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/" TEST_BANK));
+    hexfile = LittleFS.open("/" TEST_BANK, "r");
+    size_t len;
+    while ((len = hexfile.read(buf, sizeof(buf))) > 0)
+        decoder.feed(buf, len);
+    hexfile.close();
+    TEST_ASSERT_EQUAL(IHEX_DONE, decoder.finish());
+}
+// -----------------------------------------------------------------------------------------------------
+static fv1_master_cfg_t sim_config(uint32_t scl_hz, uint32_t jitter_ns, uint32_t seed, uint8_t prg)
+{
+    fv1_master_cfg_t cfg = master_defaults;
+    cfg.scl_hz = scl_hz;
+    cfg.jitter_ns = jitter_ns;
+    cfg.seed = seed;
+    cfg.prg_addr = prg * FV1_PRG_SIZE;
+    return cfg;
+}
+// -----------------------------------------------------------------------------------------------------
+static bool bit_exact(uint8_t prg)
+{
+    // data bytes and the released ACK slots, as seen by the master
+    const fv1_master_result_t &result = master.get_result();
+    if (!result.done || memcmp(master.get_data(), &bank[FV1_PRG_SIZE * prg], FV1_PRG_SIZE))
+        return false;
+    for (uint16_t clk = 8; clk < FV1M_DATA_CLOCKS; clk += 9)
+    {
+        if (!master.get_levels()[clk])
+            return false;
+    }
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+static bool sim_transfer(const fv1_master_cfg_t &cfg, uint8_t prg)
+{
+    master.set_config(cfg);
+    bool result = fv1.set_prg(prg);
+    delay(1);   // let the master finish the STOP
+    return result && bit_exact(prg);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_transfer_bit_exact(void)
+{
+    for (uint8_t prg = 0; prg < FV1_PRG_COUNT; prg++)
+    {
+        TEST_ASSERT_TRUE(sim_transfer(sim_config(SIM_HZ_MIN, 0, 1, prg), prg));
+        TEST_ASSERT_TRUE(master.get_result().acked);
+        TEST_ASSERT_EQUAL(0, master.get_result().late_bits);
+        TEST_ASSERT_EQUAL(0, master.get_result().glitches);
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void test_short_pulse_retried(void)
+{
+    // the FV-1 ignores the first two pulses, transfer() doubles the pulse until it answers
+    fv1_master_cfg_t cfg = sim_config(SIM_HZ_MIN, 0, 1, 3);
+    cfg.pulse_min_us = 3 * FV1_RST_PULSE_US;
+    uint32_t retries = fv1.get_timing().retries;
+
+    TEST_ASSERT_TRUE(sim_transfer(cfg, 3));
+    TEST_ASSERT_EQUAL(retries + 2, fv1.get_timing().retries);
+    TEST_ASSERT_EQUAL(4 * FV1_RST_PULSE_US, fv1.get_timing().rst_pulse_us);
+    fv1.set_timing(FV1_RST_PULSE_US, FV1_RST_PULSE_MAX_US, FV1_SCL_START_US, FV1_SCL_IDLE_US);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_no_master_times_out(void)
+{
+    uint32_t timeouts = fv1.get_edge_stats().timeouts;
+
+    fv1.set_timing(FV1_RST_PULSE_US, FV1_RST_PULSE_US, FV1_SCL_START_US, FV1_SCL_IDLE_US);
+    native_gpio_detach(&master);
+    TEST_ASSERT_FALSE(fv1.set_prg(0));
+    native_gpio_attach(&master);
+    TEST_ASSERT_EQUAL(timeouts + 1, fv1.get_edge_stats().timeouts);
+    TEST_ASSERT_TRUE(native_gpio_levels() & (1u << SDA));   // bus released
+    fv1.set_timing(FV1_RST_PULSE_US, FV1_RST_PULSE_MAX_US, FV1_SCL_START_US, FV1_SCL_IDLE_US);
+}
+// -----------------------------------------------------------------------------------------------------
+static void old_encoder(const uint8_t *prg, uint8_t *levels)
+{
+    // per edge encoder of trig_read before the precomputed stream (mask test, ACK branch)
+    uint8_t bit_mask = 0x80;
+    uint8_t clk_count = 0;
+    uint16_t pos = 0;
+    for (uint16_t edge = 0; edge < FV1M_DATA_CLOCKS; edge++)
+    {
+        if (clk_count != 8)
+        {
+            levels[edge] = (prg[pos] & bit_mask) ? 1 : 0;
+            bit_mask >>= 1;
+            clk_count++;
+        }
+        else
+        {
+            levels[edge] = 1;
+            clk_count = 0;
+            bit_mask = 0x80;
+            pos++;
+        }
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void test_stream_matches_old_encoder(void)
+{
+    // edge patterns and pseudo random programs, every SDA level at the FV-1 end
+    static uint8_t image[FV1_IMAGE_SIZE];
+    static uint8_t levels[FV1M_DATA_CLOCKS];
+    uint32_t seed = 0x12345678;
+    char buf[IHEX_RECORD_CHARS(16) + 1];
+
+    for (uint32_t i = 0; i < FV1_IMAGE_SIZE; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        switch (i / FV1_PRG_SIZE)
+        {
+        case 0:  image[i] = 0x00;                   break;
+        case 1:  image[i] = 0xFF;                   break;
+        case 2:  image[i] = i & 1 ? 0x55 : 0xAA;    break;
+        case 3:  image[i] = 1 << (i & 7);           break;
+        default: image[i] = seed >> 16;             break;
+        }
+    }
+    File hexfile = LittleFS.open("/pattern.hex", "w");
+    for (uint32_t addr = 0; addr < FV1_IMAGE_SIZE; addr += 16)
+        hexfile.write((const uint8_t *)buf, ihex_format_record(buf, 0x00, addr, &image[addr], 16));
+    hexfile.write((const uint8_t *)buf, ihex_format_record(buf, 0x01, 0, NULL, 0));
+    hexfile.close();
+
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/pattern.hex"));
+    for (uint8_t prg = 0; prg < FV1_PRG_COUNT; prg++)
+    {
+        master.set_config(sim_config(SIM_HZ_MIN, 0, 1, prg));
+        TEST_ASSERT_TRUE(fv1.set_prg(prg));
+        delay(1);
+        old_encoder(&image[FV1_PRG_SIZE * prg], levels);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(levels, master.get_levels(), FV1M_DATA_CLOCKS);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(&image[FV1_PRG_SIZE * prg], master.get_data(), FV1_PRG_SIZE);
+    }
+    TEST_ASSERT_EQUAL(FV1_OK, fv1.load_file("/" TEST_BANK));
+}
+// -----------------------------------------------------------------------------------------------------
+static bool sim_rate(uint32_t scl_hz, uint32_t jitter_ns)
+{
+    uint32_t seeds = jitter_ns ? SIM_SEEDS : 1;
+    for (uint32_t seed = 1; seed <= seeds; seed++)
+    {
+        uint8_t prg = seed % FV1_PRG_COUNT;
+        if (!sim_transfer(sim_config(scl_hz, jitter_ns, seed, prg), prg))
+            return false;
+    }
+    return true;
+}
+// -----------------------------------------------------------------------------------------------------
+static void sim_max_rate(uint32_t cpu_mhz, uint32_t jitter_ns)
+{
+    uint32_t lo = SIM_HZ_MIN;
+    uint32_t hi = SIM_HZ_MAX;
+
+    native_cpu.cpu_mhz = cpu_mhz;
+    // one notify pulse per transfer, a failed rate must not be hidden by retries
+    fv1.set_timing(FV1_RST_PULSE_US, FV1_RST_PULSE_US, FV1_SCL_START_US, FV1_SCL_IDLE_US);
+    TEST_ASSERT_TRUE(sim_rate(lo, jitter_ns));
+    TEST_ASSERT_FALSE(sim_rate(hi, jitter_ns));
+    while (hi - lo > SIM_HZ_STEP)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (sim_rate(mid, jitter_ns))
+            lo = mid;
+        else
+            hi = mid;
+    }
+    // poll loop usage at the highest rate
+    TEST_ASSERT_TRUE(sim_rate(lo, 0));
+    const fv1_edge_stats_t &stats = fv1.get_edge_stats();
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"case\": \"max_scl\", \"cpu_mhz\": %u, \"jitter_ns\": %u, \"setup_ns\": %u, \"seeds\": %u, "
+             "\"max_scl_hz\": %u, \"data_iters\": %u, \"margin\": %.1f}",
+             cpu_mhz, jitter_ns, master.get_config().setup_ns, jitter_ns ? SIM_SEEDS : 1, lo, stats.data_iters,
+             (double)lo / SIM_HZ_MIN);
+    if (results.length())
+        results += ",\n";
+    results += "    ";
+    results += buf;
+    native_cpu.cpu_mhz = 80;
+    fv1.set_timing(FV1_RST_PULSE_US, FV1_RST_PULSE_MAX_US, FV1_SCL_START_US, FV1_SCL_IDLE_US);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_max_scl_80mhz(void)
+{
+    sim_max_rate(80, 0);
+    sim_max_rate(80, 100);
+}
+// -----------------------------------------------------------------------------------------------------
+void test_max_scl_160mhz(void)
+{
+    sim_max_rate(160, 0);
+    sim_max_rate(160, 100);
+}
+// -----------------------------------------------------------------------------------------------------
+static void sim_write(void)
+{
+    String json = "{\n  \"suite\": \"fv1_sim\",\n  \"min_scl_hz\": " + String(SIM_HZ_MIN) + ",\n  \"results\": [\n" + results + "\n  ]\n}\n";
+    printf("%s", json.c_str());
+    const char *path = getenv("FV1_SIM_JSON");
+    if (!path)
+        return;
+    FILE *f = fopen(path, "w");
+    if (f)
+    {
+        fputs(json.c_str(), f);
+        fclose(f);
+    }
+}
+// -----------------------------------------------------------------------------------------------------
+void setUp(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+void tearDown(void)
+{
+}
+// -----------------------------------------------------------------------------------------------------
+int main(void)
+{
+    master_defaults = master.get_config();
+    native_gpio_attach(&master);
+    fv1.begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_load_bank);
+    RUN_TEST(test_transfer_bit_exact);
+    RUN_TEST(test_stream_matches_old_encoder);
+    RUN_TEST(test_short_pulse_retried);
+    RUN_TEST(test_no_master_times_out);
+    RUN_TEST(test_max_scl_80mhz);
+    RUN_TEST(test_max_scl_160mhz);
+    int failures = UNITY_END();
+    sim_write();
+    return failures;
+}